@@ -1,5 +1,7 @@
+#include "../../src/eventloop.h"
 #include "../../src/eventprovider.h"
 #include "../../src/graphicsprovider.h"
+#include "../../src/logger.h"
 #include "../../src/png_reader.h"
 #include "mp4_decoder.h"
 #include "painter.h"
@@ -13,7 +15,6 @@
 #include <filesystem>
 #include <fstream>
 #include <iostream>
-#include <thread>
 
 namespace e172::impl::console::video_player {
 
@@ -35,6 +36,14 @@ struct Flags
     bool v2;
     double contrast;
     std::uint8_t deterioration;
+    /// terminal input is recorded to this file
+    std::filesystem::path recordInput;
+    /// input is replayed from this file instead of terminal
+    std::filesystem::path replayInput;
+    /// written frames are recorded to this file
+    std::filesystem::path recordFrames;
+    /// recorded frames are written to stdout instead of playing video
+    std::filesystem::path playFrames;
 };
 
 int mainV1(int argc, const char **argv, const Flags &flags);
@@ -48,13 +57,16 @@ int main(int argc, const char **argv)
               argv,
               [](e172::FlagParser &p) {
                   return Flags{
-                      .input = p.flag<std::filesystem::path>(
-                          e172::Flag{.shortName = "i",
-                                     .longName = "input",
-                                     .description = "Input file path (.mp4 file)"}),
-                      .scale = p.flag<double>(e172::Flag{.shortName = "s",
-                                                         .longName = "scale",
-                                                         .description = "Scale of video frame"}),
+                      .input = p.flag(e172::OptFlag<std::filesystem::path>{
+                          .shortName = "i",
+                          .longName = "input",
+                          .description = "Input file path (.mp4 file). Required unless frames "
+                                         "are played",
+                          .defaultVal = {}}),
+                      .scale = p.flag(e172::OptFlag<double>{.shortName = "s",
+                                                            .longName = "scale",
+                                                            .description = "Scale of video frame",
+                                                            .defaultVal = 1}),
                       .v2 = p.flag<bool>(e172::Flag{.shortName = "v2",
                                                     .longName = "use-version2",
                                                     .description = "Use version 2"}),
@@ -66,7 +78,28 @@ int main(int argc, const char **argv)
                           e172::OptFlag<std::uint8_t>{.shortName = "d",
                                                       .longName = "deterioration",
                                                       .description = "Deterioration of color",
-                                                      .defaultVal = 32})};
+                                                      .defaultVal = 32}),
+                      .recordInput = p.flag(e172::OptFlag<std::filesystem::path>{
+                          .shortName = "ri",
+                          .longName = "record-input",
+                          .description = "Record terminal input to file (version 2)",
+                          .defaultVal = {}}),
+                      .replayInput = p.flag(e172::OptFlag<std::filesystem::path>{
+                          .shortName = "pi",
+                          .longName = "replay-input",
+                          .description = "Replay recorded input instead of reading terminal. "
+                                         "Player exits when replay ends (version 2)",
+                          .defaultVal = {}}),
+                      .recordFrames = p.flag(e172::OptFlag<std::filesystem::path>{
+                          .shortName = "rf",
+                          .longName = "record-frames",
+                          .description = "Record written frames to file (version 2)",
+                          .defaultVal = {}}),
+                      .playFrames = p.flag(e172::OptFlag<std::filesystem::path>{
+                          .shortName = "pf",
+                          .longName = "play-frames",
+                          .description = "Play recorded frames to stdout and exit",
+                          .defaultVal = {}})};
               },
               [](const e172::FlagParser &p) {
                   p.displayErr(std::cerr);
@@ -79,6 +112,17 @@ int main(int argc, const char **argv)
               nullptr)
               .value();
 
+    if (!flags.playFrames.empty()) {
+        using namespace e172::impl::console;
+        recording::Player player(flags.playFrames.string(), recording::Kind::Frames);
+        recording::play(player, std::cout);
+        return 0;
+    }
+    if (flags.input.empty()) {
+        std::cerr << "Input file is required" << std::endl;
+        return 1;
+    }
+
     if (flags.v2) {
         return mainV2(argc, argv, flags);
     } else {
@@ -90,6 +134,9 @@ int mainV1(int argc, const char **argv, const Flags &flags)
 {
     using namespace e172::impl::console;
 
+    /// created first, so that threads started below do not take SIGWINCH
+    EventLoop loop;
+
     std::iostream null(0);
 
     const auto absolutePath = std::filesystem::absolute(flags.input);
@@ -102,9 +149,11 @@ int mainV1(int argc, const char **argv, const Flags &flags)
               << "esc to exit" << std::endl
               << "To begin press any button";
 
-    EventProvider eventProvider(null);
+    Logger nullLog(null, LogLevel::Off);
+    EventProvider eventProvider(nullLog);
+    loop.watchInput(eventProvider.readyFd());
     while (!eventProvider.pullEvent()) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        loop.wait();
     }
 
     const auto graphicsProvider = std::make_shared<GraphicsProvider>(std::cout);
@@ -142,7 +191,7 @@ int mainV1(int argc, const char **argv, const Flags &flags)
     std::size_t last_w = 0;
     std::size_t last_h = 0;
 
-    e172::ElapsedTimer updateTimer(1000 / 30);
+    loop.setFrameInterval(std::chrono::milliseconds(1000 / 30));
 
 
     e172::ElapsedTimer frameChangeTimer(1000 / 4);
@@ -152,7 +201,7 @@ int mainV1(int argc, const char **argv, const Flags &flags)
     bool framesIncrementing = true;
     bool exit = false;
     while (!exit && frame_index < decoder.frameCount()) {
-        if (updateTimer.check()) {
+        if (loop.wait().frames > 0) {
             constexpr std::size_t rewindStep = 20;
 
             while (const auto &event = eventProvider.pullEvent()) {
@@ -260,8 +309,12 @@ int mainV2(int argc, const char **argv, const Flags &flags)
 
     using namespace e172::impl::console;
 
+    /// created first, so that threads started below do not take SIGWINCH
+    EventLoop loop;
+
     std::iostream null(0);
-    std::ofstream log("/tmp/console-event-provider.log");
+    std::ofstream logFile("/tmp/console-event-provider.log");
+    Logger log(logFile, LogLevel::Debug);
 
     const auto decoder = std::make_shared<video_player::MP4Decoder>(std::filesystem::absolute(
                                                                         flags.input),
@@ -279,7 +332,28 @@ int mainV2(int argc, const char **argv, const Flags &flags)
                                                    .gradient = DefaultGradient,
                                                    .contrast = flags.contrast});
 
-    const auto eventProvider = std::make_shared<EventProvider>(log);
+    /// frames are usually shown far smaller than decoded
+    graphicsProvider->setMipmapping(true);
+    /// memory of decoded frames is reported to log on exit
+    graphicsProvider->setAllocationTracing(true);
+
+    if (!flags.recordFrames.empty()) {
+        graphicsProvider->setFrameRecorder(
+            std::make_shared<recording::Recorder>(flags.recordFrames.string(),
+                                                  recording::Kind::Frames));
+    }
+
+    /// real key releases where terminal supports them
+    const auto eventProvider = std::make_shared<EventProvider>(
+        log,
+        EventProvider::Settings{.kittyKeyboard = true,
+                                .recordInput = flags.recordInput.string(),
+                                .replayInput = flags.replayInput.string()});
+
+    /// input-to-photon latency is reported to log on exit
+    const auto latencyTracker = std::make_shared<LatencyTracker>();
+    graphicsProvider->setLatencyTracker(latencyTracker);
+    eventProvider->setLatencyTracker(latencyTracker);
 
     std::cout
         << "Frame count: " << decoder->frameCount() << std::endl
@@ -296,8 +370,9 @@ int mainV2(int argc, const char **argv, const Flags &flags)
         << std::endl
         << "To begin press any button" << std::endl;
 
-    while (!eventProvider->pullEvent()) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    loop.watchInput(eventProvider->readyFd());
+    while (!eventProvider->pullEvent() && !eventProvider->replayFinished()) {
+        loop.wait();
     }
 
     app.setGraphicsProvider(graphicsProvider);
@@ -307,7 +382,11 @@ int mainV2(int argc, const char **argv, const Flags &flags)
     app.setProccedInterval(1000 / 60);
     app.setRenderInterval(1000 / 60);
 
-    app.addApplicationExtension<video_player::VideoPlayerExtension>(std::cout, decoder);
+    app.addApplicationExtension<video_player::VideoPlayerExtension>(
+        std::cout, decoder, [eventProvider] { return eventProvider->replayFinished(); });
 
-    return app.exec();
+    const auto code = app.exec();
+    log.info(graphicsProvider->memorySnapshot());
+    log.info(latencyTracker->stats());
+    return code;
 }
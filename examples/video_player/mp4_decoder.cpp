@@ -1,5 +1,6 @@
 #include "mp4_decoder.h"
 
+#include "../../src/bufferpool.h"
 #include <e172/utility/either.h>
 
 #ifdef __cplusplus
@@ -17,7 +18,9 @@ extern "C" {
 }
 #endif
 
+#include <algorithm>
 #include <e172/graphics/abstractgraphicsprovider.h>
+#include <functional>
 
 namespace e172::impl::console::video_player {
 
@@ -67,16 +70,12 @@ std::ostream &operator<<(std::ostream &stream, DecodeError err)
     return stream << "Decode error " << err.during << ": " << av_err2str(err.averrcode);
 }
 
-Either<DecodeError, Void> decodePacket(std::vector<MP4Decoder::Frame> &dst_btmps,
-                                       AVPacket *packet,
+/// `onFrame` is called for every frame decoded from packet
+Either<DecodeError, Void> decodePacket(AVPacket *packet,
                                        AVCodecContext *codecContext,
-                                       SwsContext *imageConvertContext,
                                        AVFrame *frame,
                                        std::ostream &log,
-                                       std::size_t destinationWidth,
-                                       std::size_t destinationHeight,
-                                       AVPixelFormat destinationFormat,
-                                       const e172::AbstractGraphicsProvider &graphicsProvider)
+                                       const std::function<void(AVFrame *)> &onFrame)
 {
     auto response = avcodec_send_packet(codecContext, packet);
     if (response < 0) {
@@ -117,48 +116,35 @@ Either<DecodeError, Void> decodePacket(std::vector<MP4Decoder::Frame> &dst_btmps
                 log << "\tlen 7: " << frame->linesize[7] << std::endl;
             }
 
-            pixel_primitives::bitmap btmp{new std::uint32_t[destinationWidth * destinationHeight],
-                                          static_cast<size_t>(destinationWidth),
-                                          static_cast<size_t>(destinationHeight)};
-
-            /* TODO: remove */ {
-                copyFrameToBuffer(reinterpret_cast<std::uint8_t *>(btmp.matrix),
-                                  frame,
-                                  codecContext,
-                                  imageConvertContext,
-                                  destinationWidth,
-                                  destinationHeight,
-                                  destinationFormat);
-            }
-
-            const auto image = graphicsProvider.createImage(
-                destinationWidth,
-                destinationHeight,
-                [&destinationFormat,
-                 &imageConvertContext,
-                 &frame,
-                 &codecContext](std::size_t w, std::size_t h, e172::Color *pixels) {
-                    copyFrameToBuffer(reinterpret_cast<std::uint8_t *>(pixels),
-                                      frame,
-                                      codecContext,
-                                      imageConvertContext,
-                                      w,
-                                      h,
-                                      destinationFormat);
-                });
-
-            dst_btmps.push_back({btmp, image});
+            onFrame(frame);
         }
     }
     return Right(Void{});
 }
 
+/// Bytes of image pixels and of every level of mip chain built for it (see ImageData::level),
+/// which is about a third more
+std::size_t mipmappedByteSize(std::size_t width, std::size_t height)
+{
+    auto result = BufferPool::byteSize(width * height);
+    while (width > 1 || height > 1) {
+        width = std::max<std::size_t>(width / 2, 1);
+        height = std::max<std::size_t>(height / 2, 1);
+        result += BufferPool::byteSize(width * height);
+    }
+    return result;
+}
+
 } // namespace
 
-MP4Decoder::MP4Decoder(const std::filesystem::path &path, std::ostream &log, double scale)
+MP4Decoder::MP4Decoder(const std::filesystem::path &path,
+                       std::ostream &log,
+                       double scale,
+                       std::size_t cacheBudget)
     : m_path(path)
     , m_log(log)
     , m_scale(scale)
+    , m_cacheBudget(cacheBudget)
 {
     if (path.empty()) {
         log << "You need to specify a media file." << std::endl;
@@ -307,37 +293,58 @@ MP4Decoder::MP4Decoder(const std::filesystem::path &path, std::ostream &log, dou
                                            nullptr,
                                            nullptr,
                                            nullptr);
+
+    /// mip levels are built lazily, but a frame shown scaled down gets the whole chain
+    const auto frameBytes = mipmappedByteSize(m_destinationWidth, m_destinationHeight);
+    m_cacheCapacity = std::max<std::size_t>(m_cacheBudget / std::max<std::size_t>(frameBytes, 1),
+                                            1);
+    log << "frame cache: " << m_cacheCapacity << " frames" << std::endl;
 }
 
 MP4Decoder::Frame &MP4Decoder::frame(std::size_t index,
                                      const e172::AbstractGraphicsProvider &graphicsProvider) const
 {
-    if(index < m_cache.size()) {
-        return m_cache[index];
+    if (const auto frame = cached(index)) {
+        return *frame;
+    }
+    if (index < m_nextIndex && !seek(index)) {
+        rewind();
     }
 
     int response = 0;
+    Frame *result = nullptr;
+    const auto onFrame = [&](AVFrame *frame) {
+        if (m_resync) {
+            /// index is unknown until a frame with timestamp arrives, so frames before it
+            /// are dropped
+            if (frame->best_effort_timestamp == AV_NOPTS_VALUE) {
+                return;
+            }
+            m_nextIndex = frameIndex(frame->best_effort_timestamp);
+            m_resync = false;
+        }
+        const auto decoded = m_nextIndex++;
+        /// frames between key frame and requested one are only decoded. Frames following
+        /// requested one in the same packet are kept unless they would evict it
+        if (decoded < index || cached(decoded)
+            || (result && m_cache.size() >= m_cacheCapacity)) {
+            return;
+        }
+        auto &inserted = insert(decoded, convert(frame, graphicsProvider));
+        if (decoded == index) {
+            result = &inserted;
+        }
+    };
 
     // fill the Packet with data from the Stream
     // https://ffmpeg.org/doxygen/trunk/group__lavf__decoding.html#ga4fdb3084415a82e3810de6ee60e46a61
-    while (av_read_frame(m_formatContext, m_packet) >= 0) {
+    while (!result && av_read_frame(m_formatContext, m_packet) >= 0) {
         // if it's the video stream
         if (m_packet->stream_index == m_video_stream_index) {
             m_log << "AVPacket->pts " << m_packet->pts << std::endl;
-            response = decodePacket(m_cache,
-                                    m_packet,
-                                    m_codecContext,
-                                    m_imageConvertContext,
-                                    m_frame,
-                                    m_log,
-                                    m_destinationWidth,
-                                    m_destinationHeight,
-                                    m_destinationFormat,
-                                    graphicsProvider);
-            if (response < 0)
-                break;
-
-            if (index < m_cache.size()) {
+            response = decodePacket(m_packet, m_codecContext, m_frame, m_log, onFrame);
+            if (response < 0) {
+                av_packet_unref(m_packet);
                 break;
             }
         }
@@ -345,14 +352,97 @@ MP4Decoder::Frame &MP4Decoder::frame(std::size_t index,
         av_packet_unref(m_packet);
     }
 
-    if(index < m_cache.size()) {
-        return m_cache[index];
+    if (result) {
+        return *result;
     } else {
         m_log << "frame_count: " << frameCount() << std::endl;
         throw std::runtime_error("no frame for index: " + std::to_string(index));
     }
 }
 
+MP4Decoder::Frame MP4Decoder::convert(AVFrame *frame,
+                                      const e172::AbstractGraphicsProvider &graphicsProvider) const
+{
+    Frame result;
+    BufferPool::Label label("mp4 frames");
+    result.image = graphicsProvider.createImage(
+        m_destinationWidth,
+        m_destinationHeight,
+        [this, frame, &result](std::size_t w, std::size_t h, e172::Color *pixels) {
+            copyFrameToBuffer(reinterpret_cast<std::uint8_t *>(pixels),
+                              frame,
+                              m_codecContext,
+                              m_imageConvertContext,
+                              w,
+                              h,
+                              m_destinationFormat);
+            /// image is never modified, so its pixels stay where they were written
+            result.bitmap = pixel_primitives::bitmap{reinterpret_cast<std::uint32_t *>(pixels),
+                                                     w,
+                                                     h};
+        });
+    return result;
+}
+
+MP4Decoder::Frame *MP4Decoder::cached(std::size_t index) const
+{
+    const auto it = m_cacheIndex.find(index);
+    if (it == m_cacheIndex.end()) {
+        return nullptr;
+    }
+    m_cache.splice(m_cache.end(), m_cache, it->second);
+    return &it->second->frame;
+}
+
+MP4Decoder::Frame &MP4Decoder::insert(std::size_t index, Frame &&frame) const
+{
+    /// released pixels go back to buffer pool and are reused by the frame inserted below
+    while (m_cache.size() >= m_cacheCapacity) {
+        m_cacheIndex.erase(m_cache.front().index);
+        m_cache.pop_front();
+    }
+    m_cache.push_back(CachedFrame{index, std::move(frame)});
+    m_cacheIndex[index] = std::prev(m_cache.end());
+    return m_cache.back().frame;
+}
+
+bool MP4Decoder::seek(std::size_t index) const
+{
+    const auto stream = m_formatContext->streams[m_video_stream_index];
+    const auto start = stream->start_time != AV_NOPTS_VALUE ? stream->start_time : 0;
+    const auto timestamp = start
+                           + av_rescale_q(index, av_inv_q(stream->r_frame_rate), stream->time_base);
+    if (av_seek_frame(m_formatContext, m_video_stream_index, timestamp, AVSEEK_FLAG_BACKWARD) < 0) {
+        m_log << "seek to frame " << index << " failed" << std::endl;
+        return false;
+    }
+    avcodec_flush_buffers(m_codecContext);
+    m_resync = true;
+    return true;
+}
+
+void MP4Decoder::rewind() const
+{
+    const auto stream = m_formatContext->streams[m_video_stream_index];
+    const auto start = stream->start_time != AV_NOPTS_VALUE ? stream->start_time : 0;
+    if (avformat_seek_file(m_formatContext, m_video_stream_index, INT64_MIN, start, start, 0) < 0) {
+        throw std::runtime_error("rewinding " + m_path.string() + " failed");
+    }
+    avcodec_flush_buffers(m_codecContext);
+    m_nextIndex = 0;
+    m_resync = false;
+}
+
+std::size_t MP4Decoder::frameIndex(std::int64_t timestamp) const
+{
+    const auto stream = m_formatContext->streams[m_video_stream_index];
+    const auto start = stream->start_time != AV_NOPTS_VALUE ? stream->start_time : 0;
+    const auto index = av_rescale_q(timestamp - start,
+                                    stream->time_base,
+                                    av_inv_q(stream->r_frame_rate));
+    return index > 0 ? std::size_t(index) : 0;
+}
+
 std::size_t MP4Decoder::frameCount() const
 {
     return m_formatContext ? m_formatContext->streams[m_video_stream_index]->nb_frames - 1 : 0;
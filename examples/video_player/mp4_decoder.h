@@ -5,8 +5,9 @@
 #include <e172/graphics/image.h>
 #include <e172/math/rational.h>
 #include <filesystem>
+#include <list>
 #include <ostream>
-#include <vector>
+#include <unordered_map>
 
 #ifdef __cplusplus
 extern "C" {
@@ -29,19 +30,34 @@ class AbstractGraphicsProvider;
 
 namespace e172::impl::console::video_player {
 
+/// Decoded frames are kept in LRU cache bounded by byte budget. Pixels of each frame are
+/// stored once (in the image) and come from graphics provider, whose buffer pool recycles
+/// pixels of evicted frames for newly decoded ones. Budget covers mip chain of each frame, which
+/// graphics provider builds with mipmapping enabled. Frames before the decoded position which
+/// were evicted are decoded again after seeking to preceding key frame
 class MP4Decoder
 {
 public:
     struct Frame
     {
+        /// pixels of `image`, valid while frame is alive
         pixel_primitives::bitmap bitmap;
         e172::Image image;
     };
 
-    MP4Decoder(const std::filesystem::path &path, std::ostream &log, double scale);
+    static constexpr std::size_t DefaultCacheBudget = 256 * 1024 * 1024;
 
+    MP4Decoder(const std::filesystem::path &path,
+               std::ostream &log,
+               double scale,
+               std::size_t cacheBudget = DefaultCacheBudget);
+
+    /// Returned reference is valid until the frame is evicted by later calls
     Frame &frame(std::size_t index, const e172::AbstractGraphicsProvider &graphicsProvider) const;
 
+    /// Max number of frames kept (at least one)
+    std::size_t cacheCapacity() const { return m_cacheCapacity; }
+
     std::size_t frameCount() const;
 
     Rational<std::uint32_t> frameRate() const;
@@ -54,6 +70,24 @@ public:
                 static_cast<std::uint32_t>(m_destinationHeight)};
     }
 
+private:
+    struct CachedFrame
+    {
+        std::size_t index;
+        Frame frame;
+    };
+
+    Frame convert(AVFrame *frame, const e172::AbstractGraphicsProvider &graphicsProvider) const;
+    /// Moves frame to the most recently used end
+    Frame *cached(std::size_t index) const;
+    Frame &insert(std::size_t index, Frame &&frame) const;
+    /// Positions demuxer at key frame preceding `index`
+    bool seek(std::size_t index) const;
+    /// Positions demuxer at the first frame, whose index is known without timestamps.
+    /// Fallback of seek(), throws if even that fails
+    void rewind() const;
+    std::size_t frameIndex(std::int64_t timestamp) const;
+
 private:
     std::filesystem::path m_path;
     std::ostream &m_log;
@@ -65,7 +99,15 @@ private:
     AVCodecContext *m_codecContext = nullptr;
     SwsContext *m_imageConvertContext = nullptr;
     int m_video_stream_index;
-    mutable std::vector<Frame> m_cache;
+    /// least recently used first
+    mutable std::list<CachedFrame> m_cache;
+    mutable std::unordered_map<std::size_t, std::list<CachedFrame>::iterator> m_cacheIndex;
+    std::size_t m_cacheBudget;
+    std::size_t m_cacheCapacity = 1;
+    /// index of the next frame decoder outputs
+    mutable std::size_t m_nextIndex = 0;
+    /// set after seek: index of the next frame is taken from its timestamp
+    mutable bool m_resync = false;
     std::size_t m_destinationWidth;
     std::size_t m_destinationHeight;
     AVPixelFormat m_destinationFormat;
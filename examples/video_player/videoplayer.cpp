@@ -7,9 +7,12 @@
 
 namespace e172::impl::console::video_player {
 
-VideoPlayer::VideoPlayer(e172::FactoryMeta &&meta, const std::shared_ptr<MP4Decoder> &decoder)
+VideoPlayer::VideoPlayer(e172::FactoryMeta &&meta,
+                         const std::shared_ptr<MP4Decoder> &decoder,
+                         const std::function<bool()> &inputFinished)
     : e172::Entity(std::forward<e172::FactoryMeta>(meta))
     , m_decoder(decoder)
+    , m_inputFinished(inputFinished)
     , m_frameRateTimer(1000 * (~m_decoder->frameRate()).value())
 {
     assert(m_decoder);
@@ -54,6 +57,9 @@ void VideoPlayer::proceed(e172::Context *context, e172::EventHandler *eventHandl
             context->quitLater();
         }
     }
+    if (m_inputFinished && m_inputFinished()) {
+        context->quitLater();
+    }
 
     if (m_frameRateTimer.check(m_playing)) {
         if (m_currentFrameIndex < m_decoder->frameCount() - 1) {
@@ -74,10 +80,12 @@ void VideoPlayer::render(e172::Context *context, e172::AbstractRenderer *rendere
 }
 
 VideoPlayerExtension::VideoPlayerExtension(std::ostream &output,
-                                           const std::shared_ptr<MP4Decoder> &decoder)
+                                           const std::shared_ptr<MP4Decoder> &decoder,
+                                           const std::function<bool()> &inputFinished)
     : e172::GameApplicationExtension(PostPresentExtension)
     , m_output(output)
     , m_decoder(decoder)
+    , m_inputFinished(inputFinished)
 {
     assert(m_decoder);
     assert(m_output.good());
@@ -86,7 +94,8 @@ VideoPlayerExtension::VideoPlayerExtension(std::ostream &output,
 void VideoPlayerExtension::proceed(GameApplication *application)
 {
     if (!m_player) {
-        m_player = e172::FactoryMeta::makeShared<video_player::VideoPlayer>(m_decoder);
+        m_player = e172::FactoryMeta::makeShared<video_player::VideoPlayer>(m_decoder,
+                                                                         m_inputFinished);
         application->addEntity(m_player);
     }
     m_output << "frame: " << m_player->currentFrameIndex() << "/" << m_player->frameCount() << " ("
@@ -3,6 +3,7 @@
 #include <e172/entity.h>
 #include <e172/gameapplication.h>
 #include <e172/time/elapsedtimer.h>
+#include <functional>
 
 namespace e172::impl::console::video_player {
 
@@ -11,7 +12,10 @@ class MP4Decoder;
 class VideoPlayer : public e172::Entity
 {
 public:
-    VideoPlayer(e172::FactoryMeta &&meta, const std::shared_ptr<MP4Decoder> &decoder);
+    /// Quits once `inputFinished` returns true (e.g. replayed input ended)
+    VideoPlayer(e172::FactoryMeta &&meta,
+                const std::shared_ptr<MP4Decoder> &decoder,
+                const std::function<bool()> &inputFinished = {});
 
     std::size_t currentFrameIndex() const { return m_currentFrameIndex; };
     std::size_t frameCount() const;
@@ -23,6 +27,7 @@ public:
 
 private:
     std::shared_ptr<MP4Decoder> m_decoder;
+    std::function<bool()> m_inputFinished;
     std::size_t m_currentFrameIndex = 0;
     e172::ElapsedTimer m_frameRateTimer;
     e172::Vector<double> m_centerPosition;
@@ -33,7 +38,10 @@ private:
 class VideoPlayerExtension : public e172::GameApplicationExtension
 {
 public:
-    VideoPlayerExtension(std::ostream &output, const std::shared_ptr<MP4Decoder> &decoder);
+    /// `inputFinished` is given to the player (see VideoPlayer)
+    VideoPlayerExtension(std::ostream &output,
+                         const std::shared_ptr<MP4Decoder> &decoder,
+                         const std::function<bool()> &inputFinished = {});
 
     // GameApplicationExtension interface
 public:
@@ -42,6 +50,7 @@ public:
 private:
     std::ostream &m_output;
     std::shared_ptr<MP4Decoder> m_decoder;
+    std::function<bool()> m_inputFinished;
     std::shared_ptr<VideoPlayer> m_player;
 };
 
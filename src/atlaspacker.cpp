@@ -0,0 +1,70 @@
+#include "atlaspacker.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace e172::impl::console {
+
+SkylinePacker::SkylinePacker(std::size_t width)
+    : m_width(width)
+    , m_skyline{Segment{0, 0, width}}
+{}
+
+bool SkylinePacker::insert(std::size_t w, std::size_t h, std::size_t &x, std::size_t &y)
+{
+    if (w > m_width) {
+        return false;
+    }
+
+    auto best = m_skyline.size();
+    auto bestY = std::numeric_limits<std::size_t>::max();
+    for (std::size_t i = 0; i < m_skyline.size() && m_skyline[i].x + w <= m_width; ++i) {
+        const auto top = fit(i, w);
+        if (top < bestY) {
+            bestY = top;
+            best = i;
+        }
+    }
+    if (best == m_skyline.size()) {
+        return false;
+    }
+
+    x = m_skyline[best].x;
+    y = bestY;
+    m_height = std::max(m_height, y + h);
+
+    /// new segment replaces everything under [x, x + w)
+    const auto end = x + w;
+    auto it = m_skyline.begin() + best;
+    while (it != m_skyline.end() && it->x + it->width <= end) {
+        it = m_skyline.erase(it);
+    }
+    if (it != m_skyline.end() && it->x < end) {
+        it->width -= end - it->x;
+        it->x = end;
+    }
+    it = m_skyline.insert(it, Segment{x, y + h, w});
+
+    /// merge neighbours of equal height
+    if (it != m_skyline.begin() && std::prev(it)->y == it->y) {
+        std::prev(it)->width += it->width;
+        it = std::prev(m_skyline.erase(it));
+    }
+    if (std::next(it) != m_skyline.end() && std::next(it)->y == it->y) {
+        it->width += std::next(it)->width;
+        m_skyline.erase(std::next(it));
+    }
+    return true;
+}
+
+std::size_t SkylinePacker::fit(std::size_t index, std::size_t w) const
+{
+    const auto end = m_skyline[index].x + w;
+    std::size_t result = 0;
+    for (auto i = index; i < m_skyline.size() && m_skyline[i].x < end; ++i) {
+        result = std::max(result, m_skyline[i].y);
+    }
+    return result;
+}
+
+} // namespace e172::impl::console
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace e172::impl::console {
+
+/// Skyline bottom-left packer of rectangles into an atlas of fixed width and growing height.
+/// Every rectangle is placed where its top edge ends up lowest
+class SkylinePacker
+{
+public:
+    explicit SkylinePacker(std::size_t width);
+
+    /// Returns false if rectangle is wider than atlas
+    bool insert(std::size_t w, std::size_t h, std::size_t &x, std::size_t &y);
+
+    std::size_t width() const { return m_width; }
+    /// Height occupied so far
+    std::size_t height() const { return m_height; }
+
+private:
+    /// Top edge of packed area over [x, x + width)
+    struct Segment
+    {
+        std::size_t x;
+        std::size_t y;
+        std::size_t width;
+    };
+
+    /// Returns y at which rectangle of width `w` fits when starting at segment `index`
+    std::size_t fit(std::size_t index, std::size_t w) const;
+
+private:
+    std::size_t m_width;
+    std::size_t m_height = 0;
+    /// ordered by x, covers [0, m_width)
+    std::vector<Segment> m_skyline;
+};
+
+} // namespace e172::impl::console
@@ -0,0 +1,216 @@
+#include "bufferpool.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstdlib>
+#include <new>
+
+namespace e172::impl::console {
+
+namespace {
+
+thread_local const char *currentLabel = nullptr;
+
+} // namespace
+
+BufferPool::Label::Label(const char *name)
+    : m_previous(currentLabel)
+{
+    currentLabel = name;
+}
+
+BufferPool::Label::~Label()
+{
+    currentLabel = m_previous;
+}
+
+const char *BufferPool::Label::current()
+{
+    return currentLabel;
+}
+
+BufferPool::BufferPool(std::size_t capacity)
+    : m_capacity(capacity)
+{}
+
+BufferPool::~BufferPool()
+{
+    trim();
+}
+
+std::uint32_t *BufferPool::acquire(std::size_t pixels)
+{
+    const auto bytes = byteSize(pixels);
+    std::uint32_t *result = nullptr;
+    {
+        std::lock_guard lock(m_mutex);
+        ++m_stats.liveBuffers;
+        m_stats.liveBytes += bytes;
+        m_stats.peakLiveBytes = std::max(m_stats.peakLiveBytes, m_stats.liveBytes);
+        ++m_stats.sizeHistogram[histogramBucket(bytes)];
+        const auto it = m_free.find(pixels);
+        if (it != m_free.end() && !it->second.empty()) {
+            result = it->second.back();
+            it->second.pop_back();
+            ++m_stats.reuses;
+            --m_stats.cachedBuffers;
+            m_stats.cachedBytes -= bytes;
+        } else {
+            ++m_stats.allocations;
+        }
+    }
+
+    if (!result) {
+        result = static_cast<std::uint32_t *>(std::aligned_alloc(Alignment, bytes));
+    }
+
+    std::lock_guard lock(m_mutex);
+    if (!result) {
+        --m_stats.liveBuffers;
+        m_stats.liveBytes -= bytes;
+        throw std::bad_alloc();
+    }
+    if (m_tracing) {
+        const auto label = Label::current() ? Label::current() : UnlabeledName;
+        auto &stats = m_labels[label];
+        m_owners[result] = &stats;
+        ++stats.acquisitions;
+        ++stats.liveBuffers;
+        stats.liveBytes += bytes;
+        stats.peakLiveBytes = std::max(stats.peakLiveBytes, stats.liveBytes);
+    }
+    return result;
+}
+
+void BufferPool::release(std::uint32_t *buffer, std::size_t pixels)
+{
+    if (!buffer) {
+        return;
+    }
+
+    const auto bytes = byteSize(pixels);
+    {
+        std::lock_guard lock(m_mutex);
+        ++m_stats.releases;
+        --m_stats.liveBuffers;
+        m_stats.liveBytes -= bytes;
+        if (!m_owners.empty()) {
+            if (const auto owner = m_owners.find(buffer); owner != m_owners.end()) {
+                --owner->second->liveBuffers;
+                owner->second->liveBytes -= bytes;
+                m_owners.erase(owner);
+            }
+        }
+        if (m_stats.cachedBytes + bytes <= m_capacity) {
+            m_free[pixels].push_back(buffer);
+            ++m_stats.cachedBuffers;
+            m_stats.cachedBytes += bytes;
+            return;
+        }
+        ++m_stats.evictions;
+    }
+    std::free(buffer);
+}
+
+std::size_t BufferPool::capacity() const
+{
+    std::lock_guard lock(m_mutex);
+    return m_capacity;
+}
+
+void BufferPool::setCapacity(std::size_t bytes)
+{
+    std::lock_guard lock(m_mutex);
+    m_capacity = bytes;
+    shrink(bytes);
+}
+
+void BufferPool::trim()
+{
+    std::lock_guard lock(m_mutex);
+    shrink(0);
+}
+
+BufferPool::Stats BufferPool::stats() const
+{
+    std::lock_guard lock(m_mutex);
+    return m_stats;
+}
+
+bool BufferPool::tracing() const
+{
+    std::lock_guard lock(m_mutex);
+    return m_tracing;
+}
+
+void BufferPool::setTracing(bool value)
+{
+    std::lock_guard lock(m_mutex);
+    m_tracing = value;
+}
+
+BufferPool::Snapshot BufferPool::snapshot() const
+{
+    std::lock_guard lock(m_mutex);
+    return Snapshot{m_stats, m_labels};
+}
+
+void BufferPool::resetPeak()
+{
+    std::lock_guard lock(m_mutex);
+    m_stats.peakLiveBytes = m_stats.liveBytes;
+    for (auto &[label, stats] : m_labels) {
+        stats.peakLiveBytes = stats.liveBytes;
+    }
+}
+
+std::size_t BufferPool::byteSize(std::size_t pixels)
+{
+    /// aligned_alloc requires size to be multiple of alignment
+    const auto bytes = std::max<std::size_t>(pixels * sizeof(std::uint32_t), 1);
+    return (bytes + Alignment - 1) / Alignment * Alignment;
+}
+
+std::size_t BufferPool::histogramBucket(std::size_t bytes)
+{
+    return std::min<std::size_t>(std::bit_width(bytes), HistogramBuckets - 1);
+}
+
+void BufferPool::shrink(std::size_t limit)
+{
+    for (auto it = m_free.rbegin(); it != m_free.rend() && m_stats.cachedBytes > limit; ++it) {
+        const auto bytes = byteSize(it->first);
+        auto &list = it->second;
+        while (!list.empty() && m_stats.cachedBytes > limit) {
+            std::free(list.back());
+            list.pop_back();
+            --m_stats.cachedBuffers;
+            m_stats.cachedBytes -= bytes;
+        }
+    }
+    std::erase_if(m_free, [](const auto &entry) { return entry.second.empty(); });
+}
+
+std::ostream &operator<<(std::ostream &stream, const BufferPool::Snapshot &snapshot)
+{
+    const auto &stats = snapshot.stats;
+    stream << "live: " << stats.liveBuffers << " buffers, " << stats.liveBytes << " bytes (peak "
+           << stats.peakLiveBytes << ")\n"
+           << "cached: " << stats.cachedBuffers << " buffers, " << stats.cachedBytes << " bytes\n"
+           << "allocations: " << stats.allocations << ", reuses: " << stats.reuses
+           << ", releases: " << stats.releases << ", evictions: " << stats.evictions << '\n';
+    for (std::size_t i = 0; i < stats.sizeHistogram.size(); ++i) {
+        if (stats.sizeHistogram[i] > 0) {
+            const auto from = i == 0 ? 0 : std::size_t(1) << (i - 1);
+            stream << "  >= " << from << " bytes: " << stats.sizeHistogram[i] << '\n';
+        }
+    }
+    for (const auto &[label, labelStats] : snapshot.labels) {
+        stream << label << ": " << labelStats.liveBuffers << " buffers, " << labelStats.liveBytes
+               << " bytes (peak " << labelStats.peakLiveBytes << "), "
+               << labelStats.acquisitions << " acquisitions\n";
+    }
+    return stream;
+}
+
+} // namespace e172::impl::console
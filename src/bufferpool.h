@@ -0,0 +1,134 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace e172::impl::console {
+
+/// Size-class pool of pixel buffers. Released buffers are kept in free lists keyed by
+/// pixel count and handed out again to requests of the same size, so streams of equally
+/// sized images (video frames, fragments) do not hit the system allocator.
+/// All buffers are `Alignment` bytes aligned. Thread safe.
+/// Pool also accounts live buffers. With tracing enabled every acquired buffer is attributed
+/// to the label of the innermost `Label` alive on the acquiring thread
+class BufferPool
+{
+public:
+    static constexpr std::size_t Alignment = 64;
+    static constexpr std::size_t DefaultCapacity = 64 * 1024 * 1024;
+    /// bucket i counts requests of [2^(i-1), 2^i) bytes, the last one also everything larger
+    static constexpr std::size_t HistogramBuckets = 40;
+
+    struct Stats
+    {
+        /// buffers obtained from system allocator
+        std::size_t allocations = 0;
+        /// buffers taken from free lists
+        std::size_t reuses = 0;
+        std::size_t releases = 0;
+        /// released buffers returned to system because capacity was exceeded
+        std::size_t evictions = 0;
+        std::size_t liveBuffers = 0;
+        std::size_t liveBytes = 0;
+        std::size_t cachedBuffers = 0;
+        std::size_t cachedBytes = 0;
+        /// max of liveBytes since construction or resetPeak()
+        std::size_t peakLiveBytes = 0;
+        /// sizes of all acquire() requests
+        std::array<std::size_t, HistogramBuckets> sizeHistogram = {};
+    };
+
+    struct LabelStats
+    {
+        std::size_t acquisitions = 0;
+        std::size_t liveBuffers = 0;
+        std::size_t liveBytes = 0;
+        std::size_t peakLiveBytes = 0;
+    };
+
+    struct Snapshot
+    {
+        Stats stats;
+        /// empty unless tracing is enabled. Buffers acquired outside any Label are
+        /// reported under `UnlabeledName`
+        std::map<std::string, LabelStats> labels;
+    };
+
+    static constexpr const char *UnlabeledName = "unlabeled";
+
+    /// Labels buffers acquired on this thread while it is alive. Labels nest.
+    /// `name` must outlive the scope; the pool keeps its own copy for acquired buffers
+    class Label
+    {
+    public:
+        explicit Label(const char *name);
+        Label(const Label &) = delete;
+        Label &operator=(const Label &) = delete;
+        ~Label();
+
+        /// innermost label of this thread or nullptr
+        static const char *current();
+
+    private:
+        const char *m_previous;
+    };
+
+    /// `capacity` - max bytes kept in free lists
+    BufferPool(std::size_t capacity = DefaultCapacity);
+    BufferPool(const BufferPool &) = delete;
+    BufferPool &operator=(const BufferPool &) = delete;
+    ~BufferPool();
+
+    /// Contents of returned buffer are unspecified. Never returns nullptr
+    std::uint32_t *acquire(std::size_t pixels);
+
+    /// `pixels` must be the same value buffer was acquired with
+    void release(std::uint32_t *buffer, std::size_t pixels);
+
+    std::size_t capacity() const;
+
+    /// Frees cached buffers (largest first) until they fit into new capacity
+    void setCapacity(std::size_t bytes);
+
+    /// Frees all cached buffers
+    void trim();
+
+    Stats stats() const;
+
+    /// Tracing costs a hash map update per acquire and release. Buffers acquired while
+    /// tracing was disabled are not attributed
+    bool tracing() const;
+    void setTracing(bool value);
+
+    Snapshot snapshot() const;
+    void resetPeak();
+
+    /// Bytes actually reserved for buffer of `pixels` pixels
+    static std::size_t byteSize(std::size_t pixels);
+
+private:
+    void shrink(std::size_t limit);
+    static std::size_t histogramBucket(std::size_t bytes);
+
+private:
+    mutable std::mutex m_mutex;
+    std::map<std::size_t, std::vector<std::uint32_t *>> m_free;
+    std::size_t m_capacity;
+    Stats m_stats;
+    bool m_tracing = false;
+    /// live buffer -> stats of label it was acquired under. Points into `m_labels`
+    /// whose entries are never erased, so buffers do not depend on the `Label` name
+    std::unordered_map<const std::uint32_t *, LabelStats *> m_owners;
+    std::map<std::string, LabelStats> m_labels;
+};
+
+/// Human readable report for profiling logs
+std::ostream &operator<<(std::ostream &stream, const BufferPool::Snapshot &snapshot);
+
+} // namespace e172::impl::console
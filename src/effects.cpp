@@ -0,0 +1,197 @@
+#include "effects.h"
+
+#include <algorithm>
+#include <cmath>
+#include <e172/variant.h>
+
+namespace e172::impl::console {
+
+namespace {
+
+inline std::uint8_t clampChannel(double v)
+{
+    return static_cast<std::uint8_t>(std::clamp(v, 0., 255.));
+}
+
+inline double firstParameter(const e172::VariantVector &parameters, double defaultValue)
+{
+    return parameters.empty() ? defaultValue : parameters.front().toDouble();
+}
+
+} // namespace
+
+void ChannelMapEffect::apply(const pixel_primitives::bitmap &,
+                             std::size_t,
+                             const std::size_t *,
+                             std::uint32_t *row,
+                             std::size_t count) const
+{
+    for (std::size_t i = 0; i < count; ++i) {
+        const auto argb = row[i];
+        row[i] = (argb & 0xff000000) | std::uint32_t(m_table[std::uint8_t(argb >> 16)]) << 16
+                 | std::uint32_t(m_table[std::uint8_t(argb >> 8)]) << 8
+                 | std::uint32_t(m_table[std::uint8_t(argb)]);
+    }
+}
+
+GammaEffect::GammaEffect(double gamma)
+{
+    setGamma(gamma);
+}
+
+void GammaEffect::setParameters(const VariantVector &parameters)
+{
+    setGamma(firstParameter(parameters, 1));
+}
+
+void GammaEffect::setGamma(double gamma)
+{
+    const auto exponent = gamma > 0 ? 1 / gamma : 1;
+    for (std::size_t i = 0; i < m_table.size(); ++i) {
+        m_table[i] = clampChannel(std::pow(i / 255., exponent) * 255. + 0.5);
+    }
+}
+
+ContrastEffect::ContrastEffect(double contrast)
+{
+    setContrast(contrast);
+}
+
+void ContrastEffect::setParameters(const VariantVector &parameters)
+{
+    setContrast(firstParameter(parameters, 1));
+}
+
+void ContrastEffect::setContrast(double contrast)
+{
+    for (std::size_t i = 0; i < m_table.size(); ++i) {
+        m_table[i] = clampChannel((double(i) - 0x80) * contrast + 0x80);
+    }
+}
+
+void EdgeEnhancementEffect::setParameters(const VariantVector &parameters)
+{
+    m_strength = firstParameter(parameters, 1);
+}
+
+void EdgeEnhancementEffect::apply(const pixel_primitives::bitmap &frame,
+                                  std::size_t y,
+                                  const std::size_t *columns,
+                                  std::uint32_t *row,
+                                  std::size_t count) const
+{
+    const auto up = y > 0 ? y - 1 : y;
+    const auto down = y + 1 < frame.height ? y + 1 : y;
+    for (std::size_t i = 0; i < count; ++i) {
+        const auto x = columns[i];
+        const auto left = x > 0 ? x - 1 : x;
+        const auto right = x + 1 < frame.width ? x + 1 : x;
+        const std::uint32_t neighbours[] = {frame.matrix[y * frame.width + left],
+                                            frame.matrix[y * frame.width + right],
+                                            frame.matrix[up * frame.width + x],
+                                            frame.matrix[down * frame.width + x]};
+        /// laplacian is taken from the frame like the neighbours and added to the pixel
+        /// transformed by preceding effects, so the effect can be anywhere in the chain
+        const auto center = frame.matrix[y * frame.width + x];
+        const auto current = row[i];
+        std::uint32_t result = current & 0xff000000;
+        for (std::uint32_t shift = 0; shift < 24; shift += 8) {
+            int laplacian = 4 * int((center >> shift) & 0xff);
+            for (const auto n : neighbours) {
+                laplacian -= int((n >> shift) & 0xff);
+            }
+            const auto c = int((current >> shift) & 0xff);
+            result |= std::uint32_t(clampChannel(c + m_strength * laplacian)) << shift;
+        }
+        row[i] = result;
+    }
+}
+
+void ColorKeyEffect::setParameters(const VariantVector &parameters)
+{
+    m_key = static_cast<std::uint32_t>(firstParameter(parameters, 0)) & 0x00ffffff;
+}
+
+void ColorKeyEffect::apply(const pixel_primitives::bitmap &,
+                           std::size_t,
+                           const std::size_t *,
+                           std::uint32_t *row,
+                           std::size_t count) const
+{
+    for (std::size_t i = 0; i < count; ++i) {
+        row[i] = (row[i] & 0x00ffffff) == m_key ? 0 : row[i];
+    }
+}
+
+void VignetteEffect::setParameters(const VariantVector &parameters)
+{
+    m_strength = firstParameter(parameters, 0.5);
+}
+
+void VignetteEffect::apply(const pixel_primitives::bitmap &frame,
+                           std::size_t y,
+                           const std::size_t *columns,
+                           std::uint32_t *row,
+                           std::size_t count) const
+{
+    const auto dy = double(y) / frame.height - 0.5;
+    const auto invWidth = 1. / frame.width;
+    for (std::size_t i = 0; i < count; ++i) {
+        const auto dx = columns[i] * invWidth - 0.5;
+        /// 0 in the center, 1 in the corners
+        const auto d2 = (dx * dx + dy * dy) * 2;
+        const auto factor = std::uint32_t(std::clamp(1 - m_strength * d2, 0., 1.) * 0x100);
+        const auto argb = row[i];
+        row[i] = (argb & 0xff000000) | ((((argb >> 16) & 0xff) * factor) >> 8) << 16
+                 | ((((argb >> 8) & 0xff) * factor) >> 8) << 8 | (((argb & 0xff) * factor) >> 8);
+    }
+}
+
+std::size_t EffectChain::registerEffect(const std::shared_ptr<Effect> &effect)
+{
+    m_entries.push_back(Entry{.effect = effect});
+    return m_entries.size() - 1;
+}
+
+void EffectChain::setEnabled(std::size_t index, bool enabled)
+{
+    if (index < m_entries.size()) {
+        m_entries[index].enabled = enabled;
+    }
+}
+
+void EffectChain::enableOnce(std::size_t index)
+{
+    if (index < m_entries.size()) {
+        m_entries[index].once = true;
+    }
+}
+
+bool EffectChain::active() const
+{
+    return std::any_of(m_entries.begin(), m_entries.end(), [](const Entry &e) {
+        return e.enabled || e.once;
+    });
+}
+
+void EffectChain::apply(const pixel_primitives::bitmap &frame,
+                        std::size_t y,
+                        const std::size_t *columns,
+                        std::uint32_t *row,
+                        std::size_t count) const
+{
+    for (const auto &entry : m_entries) {
+        if (entry.enabled || entry.once) {
+            entry.effect->apply(frame, y, columns, row, count);
+        }
+    }
+}
+
+void EffectChain::frameDone()
+{
+    for (auto &entry : m_entries) {
+        entry.once = false;
+    }
+}
+
+} // namespace e172::impl::console
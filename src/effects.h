@@ -0,0 +1,184 @@
+#pragma once
+
+#include "pixelprimitives.h"
+#include <array>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace e172 {
+class Variant;
+using VariantVector = std::vector<e172::Variant>;
+} // namespace e172
+
+namespace e172::impl::console {
+
+/// Post-processing effect. Applied by Writer to samples of each frame row while the row is
+/// encoded, so any number of effects costs one sweep over the frame
+class Effect
+{
+public:
+    virtual std::string name() const = 0;
+    virtual void setParameters(const e172::VariantVector &) {}
+
+    /// `row[i]` is sample of `frame` at (`columns[i]`, `y`)
+    virtual void apply(const pixel_primitives::bitmap &frame,
+                       std::size_t y,
+                       const std::size_t *columns,
+                       std::uint32_t *row,
+                       std::size_t count) const
+        = 0;
+
+    virtual ~Effect() = default;
+};
+
+/// Per channel lookup table effect
+class ChannelMapEffect : public Effect
+{
+public:
+    // Effect interface
+public:
+    virtual void apply(const pixel_primitives::bitmap &frame,
+                       std::size_t y,
+                       const std::size_t *columns,
+                       std::uint32_t *row,
+                       std::size_t count) const override;
+
+protected:
+    std::array<std::uint8_t, 0x100> m_table;
+};
+
+/// parameters: gamma (default 1)
+class GammaEffect : public ChannelMapEffect
+{
+public:
+    GammaEffect(double gamma = 1);
+
+    // Effect interface
+public:
+    virtual std::string name() const override { return "gamma"; }
+    virtual void setParameters(const e172::VariantVector &parameters) override;
+
+private:
+    void setGamma(double gamma);
+};
+
+/// parameters: contrast (default 1)
+class ContrastEffect : public ChannelMapEffect
+{
+public:
+    ContrastEffect(double contrast = 1);
+
+    // Effect interface
+public:
+    virtual std::string name() const override { return "contrast"; }
+    virtual void setParameters(const e172::VariantVector &parameters) override;
+
+private:
+    void setContrast(double contrast);
+};
+
+/// Laplacian sharpening. parameters: strength (default 1)
+class EdgeEnhancementEffect : public Effect
+{
+public:
+    EdgeEnhancementEffect(double strength = 1)
+        : m_strength(strength)
+    {}
+
+    // Effect interface
+public:
+    virtual std::string name() const override { return "edge_enhancement"; }
+    virtual void setParameters(const e172::VariantVector &parameters) override;
+    virtual void apply(const pixel_primitives::bitmap &frame,
+                       std::size_t y,
+                       const std::size_t *columns,
+                       std::uint32_t *row,
+                       std::size_t count) const override;
+
+private:
+    double m_strength;
+};
+
+/// Makes pixels of key color transparent. parameters: rgb key (default 0x000000)
+class ColorKeyEffect : public Effect
+{
+public:
+    ColorKeyEffect(std::uint32_t key = 0)
+        : m_key(key & 0x00ffffff)
+    {}
+
+    // Effect interface
+public:
+    virtual std::string name() const override { return "color_key"; }
+    virtual void setParameters(const e172::VariantVector &parameters) override;
+    virtual void apply(const pixel_primitives::bitmap &frame,
+                       std::size_t y,
+                       const std::size_t *columns,
+                       std::uint32_t *row,
+                       std::size_t count) const override;
+
+private:
+    std::uint32_t m_key;
+};
+
+/// Darkens frame towards corners. parameters: strength (default 0.5)
+class VignetteEffect : public Effect
+{
+public:
+    VignetteEffect(double strength = 0.5)
+        : m_strength(strength)
+    {}
+
+    // Effect interface
+public:
+    virtual std::string name() const override { return "vignette"; }
+    virtual void setParameters(const e172::VariantVector &parameters) override;
+    virtual void apply(const pixel_primitives::bitmap &frame,
+                       std::size_t y,
+                       const std::size_t *columns,
+                       std::uint32_t *row,
+                       std::size_t count) const override;
+
+private:
+    double m_strength;
+};
+
+class EffectChain
+{
+public:
+    /// returns index of registered effect
+    std::size_t registerEffect(const std::shared_ptr<Effect> &effect);
+
+    std::size_t count() const { return m_entries.size(); }
+    const std::shared_ptr<Effect> &effect(std::size_t index) const
+    {
+        return m_entries[index].effect;
+    }
+
+    void setEnabled(std::size_t index, bool enabled);
+    /// enables effect only for the next frame
+    void enableOnce(std::size_t index);
+
+    bool active() const;
+    void apply(const pixel_primitives::bitmap &frame,
+               std::size_t y,
+               const std::size_t *columns,
+               std::uint32_t *row,
+               std::size_t count) const;
+
+    /// resets effects enabled by `enableOnce`
+    void frameDone();
+
+private:
+    struct Entry
+    {
+        std::shared_ptr<Effect> effect;
+        bool enabled = false;
+        bool once = false;
+    };
+
+    std::vector<Entry> m_entries;
+};
+
+} // namespace e172::impl::console
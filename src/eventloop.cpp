@@ -0,0 +1,134 @@
+#include "eventloop.h"
+
+#include <cerrno>
+#include <csignal>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+namespace e172::impl::console {
+
+EventLoop::EventLoop()
+{
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGWINCH);
+    sigset_t previous;
+    ::pthread_sigmask(SIG_BLOCK, &mask, &previous);
+    m_resizeWasBlocked = sigismember(&previous, SIGWINCH) == 1;
+
+    m_epoll = ::epoll_create1(EPOLL_CLOEXEC);
+    if (m_epoll < 0) {
+        fail("creating event loop failed. epoll_create1 failed");
+    }
+    m_signal = ::signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (m_signal < 0) {
+        fail("creating event loop failed. signalfd failed");
+    }
+    m_timer = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (m_timer < 0) {
+        fail("creating event loop failed. timerfd_create failed");
+    }
+
+    add(m_signal, EPOLLIN, Resize);
+    add(m_timer, EPOLLIN, Frame);
+}
+
+EventLoop::~EventLoop()
+{
+    release();
+}
+
+void EventLoop::watchInput(int fd)
+{
+    add(fd, EPOLLIN, Input);
+    m_input = fd;
+}
+
+void EventLoop::watchOutput(int fd)
+{
+    add(fd, EPOLLOUT | EPOLLET, Output);
+}
+
+void EventLoop::setFrameInterval(std::chrono::nanoseconds interval)
+{
+    const auto ns = interval.count();
+    const timespec period{time_t(ns / 1000000000), long(ns % 1000000000)};
+    const itimerspec spec{.it_interval = period, .it_value = period};
+    ::timerfd_settime(m_timer, 0, &spec, nullptr);
+}
+
+EventLoop::Ready EventLoop::wait(std::optional<std::chrono::milliseconds> timeout)
+{
+    Ready ready;
+    epoll_event events[4];
+    int count;
+    do {
+        count = ::epoll_wait(m_epoll, events, std::size(events), timeout ? timeout->count() : -1);
+    } while (count < 0 && errno == EINTR);
+
+    for (int i = 0; i < count; ++i) {
+        switch (Source(events[i].data.u32)) {
+        case Input: {
+            std::uint64_t value;
+            [[maybe_unused]] const auto res = ::read(m_input, &value, sizeof(value));
+            ready.input = true;
+            break;
+        }
+        case Output:
+            ready.output = true;
+            break;
+        case Resize: {
+            signalfd_siginfo info;
+            while (::read(m_signal, &info, sizeof(info)) == sizeof(info)) {
+                ready.resized = true;
+            }
+            break;
+        }
+        case Frame: {
+            std::uint64_t expirations;
+            if (::read(m_timer, &expirations, sizeof(expirations)) == sizeof(expirations)) {
+                ready.frames = expirations;
+            }
+            break;
+        }
+        }
+    }
+    return ready;
+}
+
+void EventLoop::add(int fd, std::uint32_t events, Source source)
+{
+    epoll_event event{.events = events, .data = {.u32 = source}};
+    if (::epoll_ctl(m_epoll, EPOLL_CTL_ADD, fd, &event) < 0) {
+        /// loop created before stays usable, so it is released by destructor only
+        if (source == Input || source == Output) {
+            throw EventLoopException("watching descriptor failed. epoll_ctl failed");
+        }
+        fail("creating event loop failed. epoll_ctl failed");
+    }
+}
+
+void EventLoop::release()
+{
+    for (const auto fd : {m_timer, m_signal, m_epoll}) {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+    if (!m_resizeWasBlocked) {
+        sigset_t mask;
+        sigemptyset(&mask);
+        sigaddset(&mask, SIGWINCH);
+        ::pthread_sigmask(SIG_UNBLOCK, &mask, nullptr);
+    }
+}
+
+void EventLoop::fail(const char *what)
+{
+    release();
+    throw EventLoopException(what);
+}
+
+} // namespace e172::impl::console
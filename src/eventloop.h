@@ -0,0 +1,82 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <optional>
+
+namespace e172::impl::console {
+
+class EventLoopException : public std::exception
+{
+public:
+    EventLoopException(const char *what)
+        : m_what(what)
+    {}
+    const char *what() const noexcept { return m_what; }
+
+private:
+    const char *m_what;
+};
+
+/// Lets console application sleep until there is work instead of polling timers:
+/// input became available (EventProvider::readyFd()), output became writable, terminal was
+/// resized (SIGWINCH through signalfd) or frame deadline passed (timerfd).
+/// SIGWINCH is blocked in the constructing thread, so that it is delivered to the signalfd.
+/// Threads inherit the mask, hence loop should be created before any other thread is started
+/// (EventProvider, Logger, decoders), otherwise some resizes may be reported late. Destruction
+/// unblocks SIGWINCH again if it was not blocked before, so it should happen on the same thread.
+/// Failure to create or watch descriptors throws EventLoopException
+class EventLoop
+{
+public:
+    struct Ready
+    {
+        bool input = false;
+        bool output = false;
+        bool resized = false;
+        /// frame deadlines passed since previous wait. More than one means frames were missed
+        std::uint64_t frames = 0;
+    };
+
+    EventLoop();
+    EventLoop(const EventLoop &) = delete;
+    EventLoop &operator=(const EventLoop &) = delete;
+    ~EventLoop();
+
+    /// Epoll descriptor of the loop. Readable when wait() would not block, so the loop can be
+    /// nested into epoll of application
+    int fd() const { return m_epoll; }
+
+    /// `fd` is an eventfd counting input (see EventProvider::readyFd()). It is reset by wait(),
+    /// so events must be pulled after wait() returns
+    void watchInput(int fd);
+
+    /// Reports when `fd` becomes writable again (edge triggered), e.g. after write to non
+    /// blocking terminal returned EAGAIN
+    void watchOutput(int fd);
+
+    /// Zero interval stops frame timer. Deadlines are periodic from the call, so they do not
+    /// drift with time spent on frames
+    void setFrameInterval(std::chrono::nanoseconds interval);
+
+    /// Blocks until any source is ready or `timeout` passes
+    Ready wait(std::optional<std::chrono::milliseconds> timeout = std::nullopt);
+
+private:
+    enum Source : std::uint32_t { Input, Output, Resize, Frame };
+
+    void add(int fd, std::uint32_t events, Source source);
+    /// Closes descriptors and restores signal mask
+    void release();
+    [[noreturn]] void fail(const char *what);
+
+private:
+    int m_epoll = -1;
+    int m_signal = -1;
+    int m_timer = -1;
+    int m_input = -1;
+    bool m_resizeWasBlocked = false;
+};
+
+} // namespace e172::impl::console
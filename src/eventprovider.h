@@ -1,28 +1,127 @@
 #pragma once
 
+#include "inputparser.h"
+#include "latency.h"
+#include "logger.h"
+#include "recording.h"
+#include "spscqueue.h"
+#include "surface.h"
+#include <atomic>
+#include <chrono>
 #include <e172/abstracteventprovider.h>
+#include <thread>
 
 namespace e172::impl::console {
 
-class StdinSocket;
+class RawTerminal;
 
+/// Terminal input is read and parsed on a background thread which blocks in poll on stdin.
+/// Game thread only pops parsed events from a wait-free queue.
+/// With mouse enabled motion is reported as e172 mouse motion events (one per read of
+/// terminal input) and all mouse reports including buttons and wheel are available from
+/// pullMouseEvent()
 class EventProvider : public e172::AbstractEventProvider
 {
 public:
-    EventProvider(std::ostream &log);
+    using Clock = std::chrono::steady_clock;
+
+    struct TimedEvent
+    {
+        e172::Event event;
+        /// when bytes of event were read from stdin
+        Clock::time_point timestamp;
+    };
+
+    struct TimedMouseEvent
+    {
+        MouseEvent event;
+        Clock::time_point timestamp;
+    };
+
+    struct Settings
+    {
+        /// Mouse tracking takes over text selection of terminal, so it is off by default
+        bool mouse = false;
+        /// Real key presses and releases where terminal supports kitty keyboard protocol.
+        /// Other terminals keep reporting each key as press immediately followed by release
+        bool kittyKeyboard = false;
+        /// Must match Style::symbolWHFraction of graphics provider to map cells to pixels
+        double symbolWHFraction = Style{}.symbolWHFraction;
+        /// If set, bytes read from stdin are also recorded to this file
+        std::string recordInput = {};
+        /// If set, input is replayed from recording instead of stdin, which is left untouched
+        /// (so it can run without terminal). Replay ends with the recording
+        std::string replayInput = {};
+        /// Replayed input keeps recorded timing, otherwise it is fed as fast as it is pulled
+        bool replayRealTime = true;
+    };
+
+    EventProvider(Logger &log);
+    EventProvider(Logger &log, const Settings &settings);
     ~EventProvider();
 
+    /// Same as pullEvent, but also tells when event was received
+    std::optional<TimedEvent> pullTimedEvent();
+
+    /// Pulled events are reported to `tracker`. Set it before events are pulled
+    void setLatencyTracker(const std::shared_ptr<LatencyTracker> &tracker)
+    {
+        m_latencyTracker = tracker;
+    }
+
+    /// Non blocking eventfd which becomes readable when new events are queued. Reading it
+    /// resets it; events queued later make it readable again. See EventLoop::watchInput()
+    int readyFd() const { return m_readyFd; }
+
+    /// True once replay reached end of the recording and all its events were pulled, so
+    /// nothing more will come. readyFd() becomes readable when replay ends. False for terminal
+    bool replayFinished() const;
+
+    /// Mouse reports. Unlike events they are dropped if not pulled
+    std::optional<TimedMouseEvent> pullMouseEvent();
+
+    /// Position of cell in frame pixels
+    e172::Vector<double> cellPosition(std::uint32_t column, std::uint32_t row) const;
+
     // AbstractEventHandler interface
 public:
     std::optional<e172::Event> pullEvent() override;
 
 private:
-    void bufferize();
+    void run();
+    void readTerminal();
+    void replay();
+    /// False if woken for destruction
+    bool sleepUntil(Clock::time_point deadline) const;
+    void push(const std::vector<InputParser::Input> &events, Clock::time_point timestamp);
+    void push(const e172::Event &event, Clock::time_point timestamp);
+    void push(const MouseEvent &event, Clock::time_point timestamp);
 
 private:
-    std::unique_ptr<StdinSocket> m_stdinSocket;
-    std::queue<Event> m_events;
-    std::ostream &m_log;
+    static constexpr std::size_t EventQueueCapacity = 1024;
+    static constexpr std::size_t MouseQueueCapacity = 256;
+    static constexpr std::size_t ReadChunkSize = 4096;
+    static constexpr auto FullQueueBackoff = std::chrono::milliseconds(1);
+
+    const Settings m_settings;
+    /// stdin stays in raw mode while provider exists. Null while replaying
+    std::unique_ptr<RawTerminal> m_terminal;
+    /// used by input thread only
+    std::unique_ptr<InputParser> m_parser;
+    std::unique_ptr<recording::Recorder> m_recorder;
+    std::unique_ptr<recording::Player> m_player;
+    SpscQueue<TimedEvent, EventQueueCapacity> m_events;
+    SpscQueue<TimedMouseEvent, MouseQueueCapacity> m_mouseEvents;
+    /// written from both game and input threads
+    Logger &m_log;
+    std::shared_ptr<LatencyTracker> m_latencyTracker;
+    /// written to wake input thread on destruction
+    int m_wakeFd;
+    int m_readyFd;
+    std::atomic<bool> m_stopping = false;
+    /// set by input thread after the last replayed event is queued
+    std::atomic<bool> m_replayEnded = false;
+    std::thread m_inputThread;
 };
 
 } // namespace e172::impl::console
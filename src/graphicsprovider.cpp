@@ -1,15 +1,27 @@
 #include "graphicsprovider.h"
 
+#include "atlaspacker.h"
+#include <cmath>
+#include <cstring>
 #include <fstream>
+#include <numeric>
 #include "png_reader.h"
+#include "qoi.h"
+#include "rawimage.h"
 
 namespace e172::impl::console {
 
-e172::Image GraphicsProvider::imageFromBitmap(const pixel_primitives::bitmap &btmp) const
+e172::Image GraphicsProvider::imageFromBuffer(const std::shared_ptr<ImageBuffer> &buffer) const
 {
-    return imageFromData(new e172::Image::Handle<pixel_primitives::bitmap>(btmp),
-                         btmp.width,
-                         btmp.height);
+    return imageFromData(new e172::Image::Handle<ImageData>(ImageData(buffer)),
+                         buffer->bitmap().width,
+                         buffer->bitmap().height);
+}
+
+std::shared_ptr<ImageBuffer> GraphicsProvider::allocateBuffer(std::size_t width,
+                                                              std::size_t height) const
+{
+    return std::make_shared<ImageBuffer>(m_pool, width, height, m_mipmapping);
 }
 
 GraphicsProvider::GraphicsProvider(std::ostream &output, const Style &style)
@@ -21,22 +33,233 @@ std::shared_ptr<AbstractRenderer> GraphicsProvider::createRenderer(
     const std::string &, const Vector<std::uint32_t> &) const
 {
     const auto renderer = std::make_shared<Renderer>(Renderer::Private{}, m_output, m_style);
+    renderer->m_writer.setLatencyTracker(m_latencyTracker);
+    renderer->m_writer.setFrameRecorder(m_frameRecorder);
     installParentToRenderer(*renderer);
     return renderer;
 }
 
-e172::Image GraphicsProvider::loadImage(const std::string &path) const
+WorkerPool &GraphicsProvider::workers() const
+{
+    std::call_once(m_workersOnce, [this] { m_workers = std::make_unique<WorkerPool>(); });
+    return *m_workers;
+}
+
+std::shared_ptr<ImageBuffer> GraphicsProvider::loadBuffer(const std::string &path) const
 {
-    std::ifstream ifile(path, std::ios::in);
-    const auto &btmp = png::read(ifile);
+    std::error_code ec;
+    const auto mtime = std::filesystem::last_write_time(path, ec);
+    if (!ec) {
+        if (const auto cached = m_imageCache.find(path, mtime)) {
+            return cached;
+        }
+    }
+
+    std::ifstream ifile(path, std::ios::in | std::ios::binary);
+    const auto format = detectFormat(ifile);
+    std::shared_ptr<ImageBuffer> buffer;
+    if (format == ImageFormat::Raw) {
+        buffer = mapImage(path);
+    } else {
+        decodeImage(ifile, format, [this, &buffer](std::size_t width, std::size_t height) {
+            buffer = allocateBuffer(width, height);
+            return buffer->bitmap().matrix;
+        });
+        buffer = m_imageCache.deduplicate(buffer);
+    }
     ifile.close();
-    return imageFromBitmap(btmp);
+
+    if (!ec) {
+        m_imageCache.insert(path, mtime, buffer);
+    }
+    return buffer;
+}
+
+e172::Image GraphicsProvider::loadImage(const std::string &path) const
+{
+    return imageFromBuffer(loadBuffer(path));
+}
+
+std::vector<e172::Image> GraphicsProvider::loadAtlas(const std::vector<std::string> &paths,
+                                                     std::size_t maxWidth) const
+{
+    std::vector<std::shared_ptr<ImageBuffer>> sprites;
+    sprites.reserve(paths.size());
+    std::size_t area = 0;
+    std::size_t widest = 0;
+    for (const auto &path : paths) {
+        std::shared_ptr<ImageBuffer> buffer;
+        try {
+            buffer = loadBuffer(path);
+            buffer->wait();
+            area += buffer->bitmap().width * buffer->bitmap().height;
+            widest = std::max(widest, buffer->bitmap().width);
+        } catch (const std::exception &) {
+            buffer = nullptr;
+        }
+        sprites.push_back(buffer);
+    }
+
+    /// tall sprites first keep skyline flat
+    std::vector<std::size_t> order(sprites.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&sprites](std::size_t a, std::size_t b) {
+        const auto ha = sprites[a] ? sprites[a]->bitmap().height : 0;
+        const auto hb = sprites[b] ? sprites[b]->bitmap().height : 0;
+        return ha > hb;
+    });
+
+    const auto side = static_cast<std::size_t>(std::ceil(std::sqrt(double(area))));
+    SkylinePacker packer(std::max(std::min(side, maxWidth), widest));
+    std::vector<ImageData::Region> regions(sprites.size());
+    for (const auto i : order) {
+        if (sprites[i]) {
+            auto &region = regions[i];
+            region.width = sprites[i]->bitmap().width;
+            region.height = sprites[i]->bitmap().height;
+            packer.insert(region.width, region.height, region.x, region.y);
+        }
+    }
+
+    std::vector<e172::Image> result;
+    result.reserve(sprites.size());
+    if (packer.height() == 0) {
+        result.resize(sprites.size());
+        return result;
+    }
+
+    /// not mipmapped: views are drawn from atlas only when not scaled
+    const auto atlas = std::make_shared<ImageBuffer>(m_pool, packer.width(), packer.height(), false);
+    std::fill_n(atlas->bitmap().matrix, packer.width() * packer.height(), 0);
+    for (std::size_t i = 0; i < sprites.size(); ++i) {
+        if (!sprites[i]) {
+            result.push_back(e172::Image());
+            continue;
+        }
+        const auto &region = regions[i];
+        pixel_primitives::copy_region(atlas->bitmap(),
+                                      sprites[i]->bitmap(),
+                                      0,
+                                      0,
+                                      region.width,
+                                      region.height,
+                                      region.x,
+                                      region.y);
+        result.push_back(
+            imageFromData(new e172::Image::Handle<ImageData>(ImageData::view(atlas, region)),
+                          region.width,
+                          region.height));
+    }
+    return result;
+}
+
+std::vector<e172::Image> GraphicsProvider::loadImages(const std::vector<std::string> &paths) const
+{
+    std::vector<e172::Image> result;
+    result.reserve(paths.size());
+    for (const auto &path : paths) {
+        std::error_code ec;
+        const auto mtime = std::filesystem::last_write_time(path, ec);
+        if (ec) {
+            result.push_back(e172::Image());
+            continue;
+        }
+        if (const auto cached = m_imageCache.find(path, mtime)) {
+            result.push_back(imageFromBuffer(cached));
+            continue;
+        }
+
+        std::ifstream header(path, std::ios::in | std::ios::binary);
+        const auto format = detectFormat(header);
+        if (format == ImageFormat::Raw) {
+            /// mapping is as cheap as posting a task
+            try {
+                const auto buffer = mapImage(path);
+                m_imageCache.insert(path, mtime, buffer);
+                result.push_back(imageFromBuffer(buffer));
+            } catch (const raw::RawImageException &) {
+                result.push_back(e172::Image());
+            }
+            continue;
+        }
+
+        std::size_t width;
+        std::size_t height;
+        if (!(format == ImageFormat::Qoi ? qoi::readSize(header, width, height)
+                                         : png::readSize(header, width, height))) {
+            result.push_back(e172::Image());
+            continue;
+        }
+
+        const auto placeholder = allocateBuffer(width, height);
+        std::fill_n(placeholder->bitmap().matrix, width * height, 0);
+        placeholder->setReady(false);
+        m_imageCache.insert(path, mtime, placeholder);
+        result.push_back(imageFromBuffer(placeholder));
+
+        workers().post([this, path, format, placeholder] {
+            try {
+                std::ifstream ifile(path, std::ios::in | std::ios::binary);
+                decodeImage(ifile, format, [&placeholder](std::size_t width, std::size_t height) {
+                    const auto &btmp = placeholder->bitmap();
+                    if (width != btmp.width || height != btmp.height) {
+                        throw png::PNGDecodingException("file changed while loading");
+                    }
+                    return btmp.matrix;
+                });
+            } catch (const std::exception &) {
+                std::fill_n(placeholder->bitmap().matrix,
+                            placeholder->bitmap().width * placeholder->bitmap().height,
+                            0);
+                placeholder->setReady(true);
+                m_imageCache.remove(path, placeholder);
+                return;
+            }
+            placeholder->setReady(true);
+            /// already returned images keep placeholder, later loads share deduplicated pixels
+            m_imageCache.replace(path, placeholder, m_imageCache.deduplicate(placeholder));
+        });
+    }
+    return result;
+}
+
+GraphicsProvider::ImageFormat GraphicsProvider::detectFormat(std::istream &stream)
+{
+    char magic[sizeof(raw::Header::Magic)] = {};
+    stream.read(magic, sizeof(magic));
+    stream.clear();
+    stream.seekg(0);
+    if (std::memcmp(magic, "qoif", 4) == 0) {
+        return ImageFormat::Qoi;
+    }
+    if (std::memcmp(magic, raw::Header::Magic, sizeof(magic)) == 0) {
+        return ImageFormat::Raw;
+    }
+    return ImageFormat::Png;
+}
+
+void GraphicsProvider::decodeImage(std::istream &stream,
+                                   ImageFormat format,
+                                   const png::Allocator &allocate)
+{
+    if (format == ImageFormat::Qoi) {
+        qoi::read(stream, allocate);
+    } else {
+        png::read(stream, allocate);
+    }
+}
+
+std::shared_ptr<ImageBuffer> GraphicsProvider::mapImage(const std::string &path) const
+{
+    /// pixels are used straight from mapped pages. Not deduplicated since hashing would
+    /// fault in every page
+    const auto mapping = raw::map(path);
+    return std::make_shared<ImageBuffer>(m_pool, mapping.bitmap, mapping.storage, m_mipmapping);
 }
 
 e172::Image GraphicsProvider::createImage(std::size_t width, std::size_t height) const
 {
-    return imageFromBitmap(
-        pixel_primitives::bitmap{new std::uint32_t[width * height], width, height});
+    return imageFromBuffer(allocateBuffer(width, height));
 }
 
 e172::Image GraphicsProvider::createImage(std::size_t width,
@@ -44,9 +267,9 @@ e172::Image GraphicsProvider::createImage(std::size_t width,
                                           const ImageInitFunction &imageInitFunction) const
 {
     if(imageInitFunction) {
-        pixel_primitives::bitmap btmp{new std::uint32_t[width * height], width, height};
-        imageInitFunction(btmp.matrix);
-        return imageFromBitmap(btmp);
+        const auto buffer = allocateBuffer(width, height);
+        imageInitFunction(buffer->bitmap().matrix);
+        return imageFromBuffer(buffer);
     }
     return e172::Image();
 }
@@ -56,23 +279,31 @@ e172::Image GraphicsProvider::createImage(std::size_t width,
                                           const ImageInitFunctionExt &imageInitFunction) const
 {
     if(imageInitFunction) {
-        pixel_primitives::bitmap btmp{new std::uint32_t[width * height], width, height};
-        imageInitFunction(width, height, btmp.matrix);
-        return imageFromBitmap(btmp);
+        const auto buffer = allocateBuffer(width, height);
+        imageInitFunction(width, height, buffer->bitmap().matrix);
+        return imageFromBuffer(buffer);
     }
     return e172::Image();
 }
 
 void GraphicsProvider::destructImage(e172::SharedContainer::DataPtr ptr) const
 {
-    const auto &handle = e172::Image::castHandle<pixel_primitives::bitmap>(ptr);
-    delete[] handle->c.matrix;
-    delete handle;
+    /// pixels are returned to pool when the last image sharing them is destroyed
+    delete e172::Image::castHandle<ImageData>(ptr);
 }
 
 e172::SharedContainer::Ptr GraphicsProvider::imageBitMap(e172::SharedContainer::DataPtr ptr) const
 {
-    return e172::Image::castHandle<pixel_primitives::bitmap>(ptr)->c.matrix;
+    /// pixels can be modified through returned pointer at any time, so they are unshared
+    /// first and caches derived from them are not kept
+    return e172::Image::castHandle<ImageData>(ptr)->c.mutableBitmap().matrix;
+}
+
+bool GraphicsProvider::saveImage(e172::SharedContainer::DataPtr ptr, const std::string &path) const
+{
+    /// buffer is referenced for the time of encoding, so pixels can not change under encoder
+    const auto &buffer = e172::Image::castHandle<ImageData>(ptr)->c.buffer();
+    return png::save(path, buffer->bitmap(), m_saveOptions);
 }
 
 e172::SharedContainer::DataPtr GraphicsProvider::imageFragment(e172::SharedContainer::DataPtr ptr,
@@ -81,10 +312,14 @@ e172::SharedContainer::DataPtr GraphicsProvider::imageFragment(e172::SharedConta
                                                                std::size_t &w,
                                                                std::size_t &h) const
 {
-    const auto &btmp = e172::Image::castHandle<pixel_primitives::bitmap>(ptr)->c;
-    pixel_primitives::bitmap result { new std::uint32_t[w * h], std::size_t(w), std::size_t(h) };
-    pixel_primitives::blit(result, btmp, -x, -y, w, h);
-    return new e172::Image::Handle<pixel_primitives::bitmap>(result);
+    const auto &btmp = e172::Image::castHandle<ImageData>(ptr)->c.bitmap();
+    const auto buffer = allocateBuffer(w, h);
+    auto &result = buffer->bitmap();
+    if (x + w > btmp.width || y + h > btmp.height) {
+        std::fill_n(result.matrix, w * h, 0);
+    }
+    pixel_primitives::copy_translated(result, btmp, -std::int64_t(x), -std::int64_t(y));
+    return new e172::Image::Handle<ImageData>(ImageData(buffer));
 }
 
 e172::SharedContainer::DataPtr GraphicsProvider::blitImages(e172::SharedContainer::DataPtr ptr0,
@@ -94,12 +329,28 @@ e172::SharedContainer::DataPtr GraphicsProvider::blitImages(e172::SharedContaine
                                                             std::size_t &w,
                                                             std::size_t &h) const
 {
-    const auto &btmp0 = e172::Image::castHandle<pixel_primitives::bitmap>(ptr0)->c;
-    const auto &btmp1 = e172::Image::castHandle<pixel_primitives::bitmap>(ptr1)->c;
-    pixel_primitives::bitmap result { new std::uint32_t[btmp0.width * btmp1.width], btmp0.width, btmp0.height };
-    pixel_primitives::copy(result, btmp0);
-    pixel_primitives::blit(result, btmp1, x, y, w, h);
-    return new e172::Image::Handle<pixel_primitives::bitmap>(result);
+    const auto &data0 = e172::Image::castHandle<ImageData>(ptr0)->c;
+    const auto &data1 = e172::Image::castHandle<ImageData>(ptr1)->c;
+    return new e172::Image::Handle<ImageData>(data0.blitted(data1, x, y, w, h));
+}
+
+e172::SharedContainer::DataPtr GraphicsProvider::transformImage(
+    e172::SharedContainer::DataPtr ptr, std::uint64_t transformation) const
+{
+    const auto &data = e172::Image::castHandle<ImageData>(ptr)->c;
+    auto quarterTurns = transformation & TransformRotationMask;
+    bool xFlip = transformation & TransformFlipX;
+    if (transformation & TransformFlipY) {
+        /// vertical flip is horizontal flip followed by half turn
+        xFlip = !xFlip;
+        quarterTurns += 2;
+    }
+    if (quarterTurns % 4 == 0 && !xFlip) {
+        return new e172::Image::Handle<ImageData>(data);
+    }
+    /// cached in source buffer, so copies are evicted together with it
+    return new e172::Image::Handle<ImageData>(
+        ImageData(data.buffer()->transformed(quarterTurns, xFlip)));
 }
 
 e172::Vector<uint32_t> GraphicsProvider::screenSize() const
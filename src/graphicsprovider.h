@@ -1,6 +1,12 @@
 #pragma once
 
+#include "bufferpool.h"
+#include "imagecache.h"
+#include "imagedata.h"
+#include "png_reader.h"
+#include "png_writer.h"
 #include "renderer.h"
+#include "workerpool.h"
 #include <e172/graphics/abstractgraphicsprovider.h>
 
 namespace e172::impl::console {
@@ -8,13 +14,82 @@ namespace e172::impl::console {
 class GraphicsProvider : public e172::AbstractGraphicsProvider
 {
 public:
+    /// Bits of transformImage flags. AbstractGraphicsProvider::transformImage takes opaque
+    /// std::uint64_t flags, so this is the encoding of this provider and the reference for
+    /// its callers: rotation is clockwise by (flags & TransformRotationMask) quarter turns
+    /// and is applied after flips. Build flags with transformation() instead of spelling bits
+    static constexpr std::uint64_t TransformRotationMask = 0b11;
+    static constexpr std::uint64_t TransformFlipX = 1 << 2;
+    static constexpr std::uint64_t TransformFlipY = 1 << 3;
+
+    static constexpr std::uint64_t transformation(std::size_t quarterTurns,
+                                                  bool flipX = false,
+                                                  bool flipY = false)
+    {
+        return (quarterTurns & TransformRotationMask) | (flipX ? TransformFlipX : 0)
+               | (flipY ? TransformFlipY : 0);
+    }
+
+    static constexpr std::size_t DefaultAtlasWidth = 2048;
+
     GraphicsProvider(std::ostream &output, const Style &style = {});
 
+    /// Images created after enabling get lazily built mip chain, which is sampled
+    /// when image is drawn with zoom below 0.5. Costs up to 1/3 of extra memory per image
+    bool mipmapping() const { return m_mipmapping; }
+    void setMipmapping(bool value) { m_mipmapping = value; }
+
+    /// Pixel buffers of all images are recycled through this pool.
+    /// Cap of cached memory is configured with `pool().setCapacity()`
+    BufferPool &pool() const { return *m_pool; }
+    BufferPool::Stats allocationStats() const { return m_pool->stats(); }
+
+    /// Live image pixels (including mip levels and transformed copies), peak, size histogram
+    /// and, with `setAllocationTracing(true)`, live bytes per BufferPool::Label.
+    /// Pixels of memory mapped raw images are not counted
+    BufferPool::Snapshot memorySnapshot() const { return m_pool->snapshot(); }
+    void setAllocationTracing(bool value) { m_pool->setTracing(value); }
+
+    /// Tracker is given to renderers created afterwards (see LatencyTracker)
+    void setLatencyTracker(const std::shared_ptr<LatencyTracker> &tracker)
+    {
+        m_latencyTracker = tracker;
+    }
+
+    /// Recorder is given to renderers created afterwards (see Writer::setFrameRecorder)
+    void setFrameRecorder(const std::shared_ptr<recording::Recorder> &recorder)
+    {
+        m_frameRecorder = recorder;
+    }
+
+    /// Used by saveImage. Asynchronous saving is provided by Renderer
+    const png::WriteOptions &saveOptions() const { return m_saveOptions; }
+    void setSaveOptions(const png::WriteOptions &options) { m_saveOptions = options; }
+
+    /// loadImage and loadImages return images sharing pixels while file is unchanged
+    ImageCache &imageCache() const { return m_imageCache; }
+
+    /// Returns images sized from file headers immediately and decodes pixels on worker threads
+    /// (one per core). Until decoded, images are skipped by Renderer and accessing their
+    /// pixels waits for decoding. Unreadable paths give null images, images which fail to
+    /// decode stay transparent
+    std::vector<e172::Image> loadImages(const std::vector<std::string> &paths) const;
+
+    /// Loads images and packs them into one atlas bitmap. Returned images are views of
+    /// atlas regions in order of `paths`: Renderer draws them straight from the atlas
+    /// (see Renderer::drawSprites) and they are copied out when modified or transformed.
+    /// Atlas is at most `maxWidth` wide unless some image is wider. Unreadable paths give
+    /// null images
+    std::vector<e172::Image> loadAtlas(const std::vector<std::string> &paths,
+                                       std::size_t maxWidth = DefaultAtlasWidth) const;
+
     // AbstractGraphicsProvider interface
 public:
     virtual std::shared_ptr<e172::AbstractRenderer> createRenderer(
         const std::string &title, const Vector<std::uint32_t> &resolution) const override;
 
+    /// PNG, QOI and raw ARGB container (see rawimage.h) are recognized by content.
+    /// Raw images are memory mapped instead of decoded
     virtual e172::Image loadImage(const std::string &path) const override;
     virtual e172::Image createImage(std::size_t width, std::size_t height) const override;
     virtual e172::Image createImage(std::size_t width,
@@ -30,10 +105,8 @@ public:
 protected:
     virtual void destructImage(e172::SharedContainer::DataPtr ptr) const override;
     virtual e172::SharedContainer::Ptr imageBitMap(e172::SharedContainer::DataPtr ptr) const override;
-    virtual bool saveImage(e172::SharedContainer::DataPtr, const std::string &) const override
-    {
-        return false;
-    }
+    virtual bool saveImage(e172::SharedContainer::DataPtr ptr,
+                           const std::string &path) const override;
 
     virtual e172::SharedContainer::DataPtr imageFragment(e172::SharedContainer::DataPtr ptr,
                                                          std::size_t x,
@@ -49,17 +122,35 @@ protected:
                                                       std::size_t &h) const override;
 
     virtual e172::SharedContainer::DataPtr transformImage(e172::SharedContainer::DataPtr ptr,
-                                                          std::uint64_t) const override
-    {
-        return ptr;
-    }
+                                                          std::uint64_t transformation) const override;
 
 private:
-    e172::Image imageFromBitmap(const pixel_primitives::bitmap &btmp) const;
+    e172::Image imageFromBuffer(const std::shared_ptr<ImageBuffer> &buffer) const;
+    std::shared_ptr<ImageBuffer> allocateBuffer(std::size_t width, std::size_t height) const;
+    WorkerPool &workers() const;
+    /// Decodes or maps file unless it is cached
+    std::shared_ptr<ImageBuffer> loadBuffer(const std::string &path) const;
+
+    /// Unknown data is reported as PNG, so that png::read reports an error
+    enum class ImageFormat { Png, Qoi, Raw };
+    static ImageFormat detectFormat(std::istream &stream);
+    static void decodeImage(std::istream &stream,
+                            ImageFormat format,
+                            const png::Allocator &allocate);
+    std::shared_ptr<ImageBuffer> mapImage(const std::string &path) const;
 
 private:
     std::ostream &m_output;
     Style m_style;
+    bool m_mipmapping = false;
+    std::shared_ptr<BufferPool> m_pool = std::make_shared<BufferPool>();
+    png::WriteOptions m_saveOptions;
+    std::shared_ptr<LatencyTracker> m_latencyTracker;
+    std::shared_ptr<recording::Recorder> m_frameRecorder;
+    mutable ImageCache m_imageCache;
+    mutable std::once_flag m_workersOnce;
+    /// declared last so that pending decodes finish before other members are destroyed
+    mutable std::unique_ptr<WorkerPool> m_workers;
 };
 
 } // namespace e172::impl::console
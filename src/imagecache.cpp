@@ -0,0 +1,112 @@
+#include "imagecache.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace e172::impl::console {
+
+std::shared_ptr<ImageBuffer> ImageCache::find(const std::string &path, Time mtime) const
+{
+    std::lock_guard lock(m_mutex);
+    const auto it = m_entries.find(path);
+    if (it != m_entries.end() && it->second.mtime == mtime) {
+        return it->second.buffer.lock();
+    }
+    return nullptr;
+}
+
+void ImageCache::insert(const std::string &path,
+                        Time mtime,
+                        const std::shared_ptr<ImageBuffer> &buffer)
+{
+    buffer->setImmutable();
+    std::lock_guard lock(m_mutex);
+    /// entries of destroyed buffers are dropped here, so they do not pile up
+    std::erase_if(m_entries, [](const auto &entry) { return entry.second.buffer.expired(); });
+    m_entries.insert_or_assign(path, Entry{mtime, buffer});
+}
+
+void ImageCache::replace(const std::string &path,
+                         const std::shared_ptr<ImageBuffer> &from,
+                         const std::shared_ptr<ImageBuffer> &to)
+{
+    std::lock_guard lock(m_mutex);
+    const auto it = m_entries.find(path);
+    if (it != m_entries.end() && it->second.buffer.lock() == from) {
+        to->setImmutable();
+        it->second.buffer = to;
+    }
+}
+
+void ImageCache::remove(const std::string &path, const std::shared_ptr<ImageBuffer> &buffer)
+{
+    std::lock_guard lock(m_mutex);
+    const auto it = m_entries.find(path);
+    if (it != m_entries.end() && it->second.buffer.lock() == buffer) {
+        m_entries.erase(it);
+    }
+}
+
+std::shared_ptr<ImageBuffer> ImageCache::deduplicate(const std::shared_ptr<ImageBuffer> &buffer)
+{
+    const auto &btmp = buffer->bitmap();
+    const auto key = hash(btmp);
+
+    std::lock_guard lock(m_mutex);
+    auto [it, end] = m_contents.equal_range(key);
+    while (it != end) {
+        const auto candidate = it->second.lock();
+        if (!candidate) {
+            it = m_contents.erase(it);
+            continue;
+        }
+        /// hash is only a hint. Registered buffers are immutable, so their pixels are compared
+        /// without synchronizing with images using them
+        const auto &other = candidate->bitmap();
+        if (other.width == btmp.width && other.height == btmp.height
+            && std::memcmp(other.matrix,
+                           btmp.matrix,
+                           btmp.width * btmp.height * sizeof(std::uint32_t))
+                   == 0) {
+            return candidate;
+        }
+        ++it;
+    }
+    buffer->setImmutable();
+    m_contents.emplace(key, buffer);
+    return buffer;
+}
+
+void ImageCache::clear()
+{
+    std::lock_guard lock(m_mutex);
+    m_entries.clear();
+    m_contents.clear();
+}
+
+std::size_t ImageCache::size() const
+{
+    std::lock_guard lock(m_mutex);
+    return std::count_if(m_entries.begin(), m_entries.end(), [](const auto &entry) {
+        return !entry.second.buffer.expired();
+    });
+}
+
+std::uint64_t ImageCache::hash(const pixel_primitives::bitmap &bitmap)
+{
+    /// FNV-1a over pixels
+    std::uint64_t result = 0xcbf29ce484222325;
+    const auto mix = [&result](std::uint64_t value) {
+        result ^= value;
+        result *= 0x100000001b3;
+    };
+    mix(bitmap.width);
+    mix(bitmap.height);
+    const auto count = bitmap.width * bitmap.height;
+    for (std::size_t i = 0; i < count; ++i) {
+        mix(bitmap.matrix[i]);
+    }
+    return result;
+}
+
+} // namespace e172::impl::console
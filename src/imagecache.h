@@ -0,0 +1,57 @@
+#pragma once
+
+#include "imagedata.h"
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace e172::impl::console {
+
+/// Buffers of loaded images keyed by path and modification time. Buffers with identical
+/// pixels are stored once. Cache holds weak references, so buffers are freed with the last
+/// image using them. Stored buffers are made immutable, so images loaded from the cache are
+/// unshared before being modified. Thread safe
+class ImageCache
+{
+public:
+    using Time = std::filesystem::file_time_type;
+
+    /// Buffer stored for `path` if the file was not modified since and the buffer is alive
+    std::shared_ptr<ImageBuffer> find(const std::string &path, Time mtime) const;
+
+    void insert(const std::string &path, Time mtime, const std::shared_ptr<ImageBuffer> &buffer);
+
+    /// Replaces buffer stored for `path` only if it is still `from`
+    void replace(const std::string &path,
+                 const std::shared_ptr<ImageBuffer> &from,
+                 const std::shared_ptr<ImageBuffer> &to);
+
+    /// Removes entry of `path` only if it still holds `buffer`
+    void remove(const std::string &path, const std::shared_ptr<ImageBuffer> &buffer);
+
+    /// Returns previously seen buffer with the same size and pixels or registers `buffer`
+    /// and returns it. `buffer` must be ready and not modified concurrently. Registered
+    /// buffers are made immutable, so later images modify copies of them
+    std::shared_ptr<ImageBuffer> deduplicate(const std::shared_ptr<ImageBuffer> &buffer);
+
+    void clear();
+    /// Number of paths whose buffers are alive
+    std::size_t size() const;
+
+private:
+    static std::uint64_t hash(const pixel_primitives::bitmap &bitmap);
+
+private:
+    struct Entry
+    {
+        Time mtime;
+        std::weak_ptr<ImageBuffer> buffer;
+    };
+
+    mutable std::mutex m_mutex;
+    std::unordered_map<std::string, Entry> m_entries;
+    std::unordered_multimap<std::uint64_t, std::weak_ptr<ImageBuffer>> m_contents;
+};
+
+} // namespace e172::impl::console
@@ -0,0 +1,199 @@
+#include "imagedata.h"
+
+#include <cmath>
+
+namespace e172::impl::console {
+
+ImageBuffer::ImageBuffer(const std::shared_ptr<BufferPool> &pool,
+                         std::size_t width,
+                         std::size_t height,
+                         bool mipmapped)
+    : m_pool(pool)
+    , m_bitmap{pool->acquire(width * height), width, height}
+    , m_mipmaps(mipmapped ? std::make_unique<Mipmaps>() : nullptr)
+{}
+
+ImageBuffer::ImageBuffer(const std::shared_ptr<BufferPool> &pool,
+                         const pixel_primitives::bitmap &bitmap,
+                         const std::shared_ptr<void> &storage,
+                         bool mipmapped)
+    : m_pool(pool)
+    , m_bitmap(bitmap)
+    , m_storage(storage)
+    , m_mipmaps(mipmapped ? std::make_unique<Mipmaps>() : nullptr)
+{}
+
+ImageBuffer::~ImageBuffer()
+{
+    releaseMipmaps();
+    if (!m_storage) {
+        m_pool->release(m_bitmap.matrix, m_bitmap.width * m_bitmap.height);
+    }
+}
+
+const pixel_primitives::bitmap &ImageBuffer::level(double scale, double &levelScale) const
+{
+    levelScale = scale;
+    if (!m_mipmaps || !m_bitmap || !(scale > 0) || scale > 0.5) {
+        return m_bitmap;
+    }
+
+    if (m_exposed) {
+        releaseMipmaps();
+    }
+    const auto requested = static_cast<std::size_t>(std::floor(std::log2(1 / scale)));
+    auto &levels = m_mipmaps->levels;
+    while (levels.size() < requested) {
+        /// copied since push_back below may reallocate levels
+        const auto prev = levels.empty() ? m_bitmap : levels.back();
+        if (prev.width == 1 && prev.height == 1) {
+            break;
+        }
+        const auto w = std::max<std::size_t>(prev.width / 2, 1);
+        const auto h = std::max<std::size_t>(prev.height / 2, 1);
+        levels.push_back(pixel_primitives::bitmap{m_pool->acquire(w * h), w, h});
+        pixel_primitives::downsample(levels.back(), prev);
+    }
+
+    if (levels.empty()) {
+        return m_bitmap;
+    }
+    const auto &result = levels[std::min(requested, levels.size()) - 1];
+    levelScale = scale * double(m_bitmap.width) / double(result.width);
+    return result;
+}
+
+void ImageBuffer::invalidateCaches() const
+{
+    releaseMipmaps();
+    m_transformed.reset();
+}
+
+void ImageBuffer::releaseMipmaps() const
+{
+    if (m_mipmaps) {
+        for (const auto &level : m_mipmaps->levels) {
+            m_pool->release(level.matrix, level.width * level.height);
+        }
+        m_mipmaps->levels.clear();
+    }
+}
+
+std::shared_ptr<ImageBuffer> ImageBuffer::transformed(std::size_t quarterTurns, bool xFlip) const
+{
+    quarterTurns %= 4;
+    if (!m_transformed || m_exposed) {
+        m_transformed = std::make_unique<std::array<std::shared_ptr<ImageBuffer>, 8>>();
+    }
+    auto &result = (*m_transformed)[quarterTurns * 2 + xFlip];
+    if (!result) {
+        const auto swap = quarterTurns % 2 == 1;
+        result = std::make_shared<ImageBuffer>(m_pool,
+                                               swap ? m_bitmap.height : m_bitmap.width,
+                                               swap ? m_bitmap.width : m_bitmap.height,
+                                               mipmapped());
+        pixel_primitives::rotate_quarter(result->m_bitmap, m_bitmap, quarterTurns, xFlip);
+    }
+    return result;
+}
+
+std::shared_ptr<ImageBuffer> ImageBuffer::clone() const
+{
+    const auto result = std::make_shared<ImageBuffer>(m_pool,
+                                                      m_bitmap.width,
+                                                      m_bitmap.height,
+                                                      mipmapped());
+    std::copy_n(m_bitmap.matrix, m_bitmap.width * m_bitmap.height, result->m_bitmap.matrix);
+    return result;
+}
+
+std::shared_ptr<ImageBuffer> ImageBuffer::cropped(std::size_t x,
+                                                  std::size_t y,
+                                                  std::size_t w,
+                                                  std::size_t h) const
+{
+    const auto result = std::make_shared<ImageBuffer>(m_pool, w, h, mipmapped());
+    pixel_primitives::copy_region(result->m_bitmap, m_bitmap, x, y, w, h, 0, 0);
+    return result;
+}
+
+ImageData::ImageData(const std::shared_ptr<ImageBuffer> &buffer)
+    : m_state(std::make_shared<State>(State{buffer, {}, nullptr, {}}))
+{}
+
+ImageData ImageData::view(const std::shared_ptr<ImageBuffer> &atlas, const Region &region)
+{
+    return ImageData(std::make_shared<State>(State{nullptr, {}, atlas, region}));
+}
+
+pixel_primitives::bitmap &ImageData::mutableBitmap() const
+{
+    detach();
+    auto &buffer = *m_state->buffer;
+    buffer.invalidateCaches();
+    buffer.expose();
+    return buffer.bitmap();
+}
+
+const std::shared_ptr<ImageBuffer> &ImageData::buffer() const
+{
+    materialize();
+    m_state->buffer->wait();
+    if (!m_state->pending.empty()) {
+        detach();
+    }
+    return m_state->buffer;
+}
+
+ImageData ImageData::blitted(const ImageData &src,
+                             std::ptrdiff_t x,
+                             std::ptrdiff_t y,
+                             std::size_t w,
+                             std::size_t h) const
+{
+    /// source is resolved now, so later changes of it do not leak into the result
+    std::shared_ptr<const ImageBuffer> source = src.buffer();
+    materialize();
+    if (m_state->buffer.use_count() == 1 && !m_state->buffer->immutable()) {
+        /// nobody else sees the buffer, so earlier blits are applied in place and
+        /// chains of blits do not accumulate
+        buffer();
+    }
+    auto pending = m_state->pending;
+    pending.push_back(Blit{std::move(source), x, y, w, h});
+    return ImageData(std::make_shared<State>(State{m_state->buffer, std::move(pending), nullptr, {}}));
+}
+
+void ImageData::materialize() const
+{
+    auto &state = *m_state;
+    if (!state.buffer) {
+        state.atlas->wait();
+        const auto &region = state.region;
+        state.buffer = state.atlas->cropped(region.x, region.y, region.width, region.height);
+    }
+}
+
+void ImageData::detach() const
+{
+    materialize();
+    auto &state = *m_state;
+    state.buffer->wait();
+    if (state.buffer.use_count() > 1 || state.buffer->immutable()) {
+        state.buffer = state.buffer->clone();
+    }
+    if (!state.pending.empty()) {
+        for (const auto &blit : state.pending) {
+            pixel_primitives::blit_translated(state.buffer->bitmap(),
+                                              blit.src->bitmap(),
+                                              blit.x,
+                                              blit.y,
+                                              blit.w,
+                                              blit.h);
+        }
+        state.pending.clear();
+        state.buffer->invalidateCaches();
+    }
+}
+
+} // namespace e172::impl::console
@@ -0,0 +1,187 @@
+#pragma once
+
+#include "bufferpool.h"
+#include "pixelprimitives.h"
+#include <array>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace e172::impl::console {
+
+/// Pixels of one or more images. Matrix is acquired from pool and returned to it on destruction
+/// unless it is owned by external storage
+class ImageBuffer
+{
+public:
+    ImageBuffer(const std::shared_ptr<BufferPool> &pool,
+                std::size_t width,
+                std::size_t height,
+                bool mipmapped);
+    /// Adopts pixels owned by `storage` (e.g. mapped file). Copies are allocated from `pool`
+    ImageBuffer(const std::shared_ptr<BufferPool> &pool,
+                const pixel_primitives::bitmap &bitmap,
+                const std::shared_ptr<void> &storage,
+                bool mipmapped);
+    ImageBuffer(const ImageBuffer &) = delete;
+    ImageBuffer &operator=(const ImageBuffer &) = delete;
+    ~ImageBuffer();
+
+    const pixel_primitives::bitmap &bitmap() const { return m_bitmap; }
+    pixel_primitives::bitmap &bitmap() { return m_bitmap; }
+
+    bool mipmapped() const { return m_mipmaps != nullptr; }
+
+    /// Buffer is not ready while its pixels are being decoded on another thread
+    bool ready() const { return m_ready.load(std::memory_order_acquire); }
+    void wait() const { m_ready.wait(false, std::memory_order_acquire); }
+    void setReady(bool ready)
+    {
+        m_ready.store(ready, std::memory_order_release);
+        m_ready.notify_all();
+    }
+
+    /// Immutable buffers are never modified in place, images copy them first. Set before the
+    /// buffer becomes reachable by other threads without an owning reference (ImageCache)
+    bool immutable() const { return m_immutable.load(std::memory_order_acquire); }
+    void setImmutable() { m_immutable.store(true, std::memory_order_release); }
+
+    /// Returns the smallest mip level which is still not coarser than `scale` requires
+    /// and writes scale which must be applied to that level into `levelScale`
+    const pixel_primitives::bitmap &level(double scale, double &levelScale) const;
+
+    /// Copy mirrored horizontally if `xFlip` and then rotated clockwise by `quarterTurns`.
+    /// Kept until pixels are modified or this buffer is destroyed, so repeated requests of
+    /// the same orientation are an array lookup
+    std::shared_ptr<ImageBuffer> transformed(std::size_t quarterTurns, bool xFlip) const;
+
+    /// Must be called when pixels are modified. Drops mip levels and transformed copies
+    void invalidateCaches() const;
+
+    /// Pixels were handed out through raw pointer and may be written at any time. Mip levels
+    /// and transformed copies of exposed buffer are rebuilt on every request
+    void expose() { m_exposed = true; }
+
+    /// Buffer with the same pixels allocated from the same pool
+    std::shared_ptr<ImageBuffer> clone() const;
+
+    /// Buffer with w x h part starting at (x, y) allocated from the same pool
+    std::shared_ptr<ImageBuffer> cropped(std::size_t x,
+                                         std::size_t y,
+                                         std::size_t w,
+                                         std::size_t h) const;
+
+private:
+    struct Mipmaps
+    {
+        /// levels[0] is level 1 (half of base size). Pixels are acquired from pool
+        std::vector<pixel_primitives::bitmap> levels;
+    };
+
+    void releaseMipmaps() const;
+
+    std::shared_ptr<BufferPool> m_pool;
+    pixel_primitives::bitmap m_bitmap;
+    /// if set pixels are not returned to pool
+    std::shared_ptr<void> m_storage;
+    std::unique_ptr<Mipmaps> m_mipmaps;
+    std::atomic<bool> m_ready = true;
+    std::atomic<bool> m_immutable = false;
+    bool m_exposed = false;
+    /// indexed by quarterTurns * 2 + xFlip
+    mutable std::unique_ptr<std::array<std::shared_ptr<ImageBuffer>, 8>> m_transformed;
+};
+
+/// Payload of e172::Image handles created by GraphicsProvider. Copies of ImageData share state.
+/// Images are copy-on-write: result of blitted() shares buffer with destination and only
+/// records the blit. Pending blits are applied when pixels are requested - in place if no
+/// other image references the buffer by then (typical `image = image.blit(...)`), otherwise
+/// into a copy.
+/// Image may also be a view of region of an atlas buffer. Views are drawn straight from the
+/// atlas and are copied out on first access to their own pixels
+class ImageData
+{
+public:
+    struct Region
+    {
+        std::size_t x;
+        std::size_t y;
+        std::size_t width;
+        std::size_t height;
+    };
+
+    explicit ImageData(const std::shared_ptr<ImageBuffer> &buffer);
+
+    static ImageData view(const std::shared_ptr<ImageBuffer> &atlas, const Region &region);
+
+    /// Pixels with all pending blits applied. Waits until buffer is ready
+    const pixel_primitives::bitmap &bitmap() const { return buffer()->bitmap(); }
+
+    /// Pixels which can be modified without affecting other images. They may be modified
+    /// as long as the image lives, so the buffer is exposed (see ImageBuffer::expose)
+    pixel_primitives::bitmap &mutableBitmap() const;
+
+    /// Waits until buffer is ready
+    const std::shared_ptr<ImageBuffer> &buffer() const;
+
+    /// False while pixels are decoded asynchronously
+    bool ready() const { return source()->ready(); }
+
+    bool mipmapped() const { return source()->mipmapped(); }
+
+    /// Region of atlas() for views which were not copied out yet, nullptr otherwise
+    const Region *region() const { return m_state->buffer ? nullptr : &m_state->region; }
+    const std::shared_ptr<ImageBuffer> &atlas() const { return m_state->atlas; }
+
+    /// See ImageBuffer::level
+    const pixel_primitives::bitmap &level(double scale, double &levelScale) const
+    {
+        return buffer()->level(scale, levelScale);
+    }
+
+    /// This image with top left w x h part of `src` blended at (x, y)
+    ImageData blitted(const ImageData &src,
+                      std::ptrdiff_t x,
+                      std::ptrdiff_t y,
+                      std::size_t w,
+                      std::size_t h) const;
+
+private:
+    struct Blit
+    {
+        std::shared_ptr<const ImageBuffer> src;
+        std::ptrdiff_t x;
+        std::ptrdiff_t y;
+        std::size_t w;
+        std::size_t h;
+    };
+
+    struct State
+    {
+        /// null for views until copied out
+        std::shared_ptr<ImageBuffer> buffer;
+        std::vector<Blit> pending;
+        std::shared_ptr<ImageBuffer> atlas;
+        Region region;
+    };
+
+    ImageData(const std::shared_ptr<State> &state)
+        : m_state(state)
+    {}
+
+    const std::shared_ptr<ImageBuffer> &source() const
+    {
+        return m_state->buffer ? m_state->buffer : m_state->atlas;
+    }
+
+    /// Copies view out of atlas
+    void materialize() const;
+
+    /// Waits until buffer is ready and makes it referenced only by this state
+    void detach() const;
+
+private:
+    std::shared_ptr<State> m_state;
+};
+
+} // namespace e172::impl::console
@@ -0,0 +1,570 @@
+#include "inputparser.h"
+
+#include <csignal>
+#include <limits>
+
+namespace e172::impl::console {
+
+namespace {
+
+struct AsciiKey
+{
+    e172::Scancode scancode;
+    std::uint8_t modifiers;
+};
+
+constexpr e172::Scancode Letters[] = {
+    e172::ScancodeA, e172::ScancodeB, e172::ScancodeC, e172::ScancodeD, e172::ScancodeE,
+    e172::ScancodeF, e172::ScancodeG, e172::ScancodeH, e172::ScancodeI, e172::ScancodeJ,
+    e172::ScancodeK, e172::ScancodeL, e172::ScancodeM, e172::ScancodeN, e172::ScancodeO,
+    e172::ScancodeP, e172::ScancodeQ, e172::ScancodeR, e172::ScancodeS, e172::ScancodeT,
+    e172::ScancodeU, e172::ScancodeV, e172::ScancodeW, e172::ScancodeX, e172::ScancodeY,
+    e172::ScancodeZ,
+};
+
+constexpr e172::Scancode Digits[] = {
+    e172::Scancode0, e172::Scancode1, e172::Scancode2, e172::Scancode3, e172::Scancode4,
+    e172::Scancode5, e172::Scancode6, e172::Scancode7, e172::Scancode8, e172::Scancode9,
+};
+
+/// US layout key producing each ASCII byte
+constexpr std::array<AsciiKey, 128> makeAsciiKeys()
+{
+    std::array<AsciiKey, 128> keys = {};
+    for (auto &key : keys) {
+        key = {e172::ScancodeUnknown, 0};
+    }
+    for (std::size_t i = 0; i < 26; ++i) {
+        keys['a' + i] = {Letters[i], 0};
+        keys['A' + i] = {Letters[i], InputParser::Shift};
+        /// Ctrl + letter
+        keys[1 + i] = {Letters[i], InputParser::Ctrl};
+    }
+    for (std::size_t i = 0; i < 10; ++i) {
+        keys['0' + i] = {Digits[i], 0};
+    }
+
+    keys[0x00] = {e172::ScancodeSpace, InputParser::Ctrl};
+    keys[0x08] = {e172::ScancodeBackspace, 0};
+    keys['\t'] = {e172::ScancodeTab, 0};
+    /// CR is translated to LF by terminal (ICRNL)
+    keys['\n'] = {e172::ScancodeReturn, 0};
+    keys['\r'] = {e172::ScancodeReturn, 0};
+    keys[0x1B] = {e172::ScancodeEscape, 0};
+    keys[0x1C] = {e172::ScancodeBackslash, InputParser::Ctrl};
+    keys[0x1D] = {e172::ScancodeRightBracket, InputParser::Ctrl};
+    keys[0x1E] = {e172::Scancode6, InputParser::Ctrl | InputParser::Shift};
+    keys[0x1F] = {e172::ScancodeMinus, InputParser::Ctrl | InputParser::Shift};
+    keys[0x7F] = {e172::ScancodeBackspace, 0};
+
+    keys[' '] = {e172::ScancodeSpace, 0};
+    keys['!'] = {e172::Scancode1, InputParser::Shift};
+    keys['"'] = {e172::ScancodeApostrophe, InputParser::Shift};
+    keys['#'] = {e172::Scancode3, InputParser::Shift};
+    keys['$'] = {e172::Scancode4, InputParser::Shift};
+    keys['%'] = {e172::Scancode5, InputParser::Shift};
+    keys['&'] = {e172::Scancode7, InputParser::Shift};
+    keys['\''] = {e172::ScancodeApostrophe, 0};
+    keys['('] = {e172::Scancode9, InputParser::Shift};
+    keys[')'] = {e172::Scancode0, InputParser::Shift};
+    keys['*'] = {e172::Scancode8, InputParser::Shift};
+    keys['+'] = {e172::ScancodeEquals, InputParser::Shift};
+    keys[','] = {e172::ScancodeComma, 0};
+    keys['-'] = {e172::ScancodeMinus, 0};
+    keys['.'] = {e172::ScancodePeriod, 0};
+    keys['/'] = {e172::ScancodeSlash, 0};
+    keys[':'] = {e172::ScancodeSemicolon, InputParser::Shift};
+    keys[';'] = {e172::ScancodeSemicolon, 0};
+    keys['<'] = {e172::ScancodeComma, InputParser::Shift};
+    keys['='] = {e172::ScancodeEquals, 0};
+    keys['>'] = {e172::ScancodePeriod, InputParser::Shift};
+    keys['?'] = {e172::ScancodeSlash, InputParser::Shift};
+    keys['@'] = {e172::Scancode2, InputParser::Shift};
+    keys['['] = {e172::ScancodeLeftBracket, 0};
+    keys['\\'] = {e172::ScancodeBackslash, 0};
+    keys[']'] = {e172::ScancodeRightBracket, 0};
+    keys['^'] = {e172::Scancode6, InputParser::Shift};
+    keys['_'] = {e172::ScancodeMinus, InputParser::Shift};
+    keys['`'] = {e172::ScancodeGrave, 0};
+    keys['{'] = {e172::ScancodeLeftBracket, InputParser::Shift};
+    keys['|'] = {e172::ScancodeBackslash, InputParser::Shift};
+    keys['}'] = {e172::ScancodeRightBracket, InputParser::Shift};
+    keys['~'] = {e172::ScancodeGrave, InputParser::Shift};
+    return keys;
+}
+
+constexpr auto AsciiKeys = makeAsciiKeys();
+
+constexpr e172::Byte PasteTerminator[] = {0x1B, '[', '2', '0', '1', '~'};
+
+constexpr e172::Scancode FunctionKeys[] = {
+    e172::ScancodeF1, e172::ScancodeF2, e172::ScancodeF3,  e172::ScancodeF4,
+    e172::ScancodeF5, e172::ScancodeF6, e172::ScancodeF7,  e172::ScancodeF8,
+    e172::ScancodeF9, e172::ScancodeF10, e172::ScancodeF11, e172::ScancodeF12,
+};
+
+/// Keys of `CSI n ~` sequences
+e172::Scancode tildeKey(std::uint32_t code)
+{
+    switch (code) {
+    case 1:
+    case 7:
+        return e172::ScancodeHome;
+    case 2:
+        return e172::ScancodeInsert;
+    case 3:
+        return e172::ScancodeDelete;
+    case 4:
+    case 8:
+        return e172::ScancodeEnd;
+    case 5:
+        return e172::ScancodePageUp;
+    case 6:
+        return e172::ScancodePageDown;
+    case 11:
+    case 12:
+    case 13:
+    case 14:
+    case 15:
+        return FunctionKeys[code - 11];
+    case 17:
+    case 18:
+    case 19:
+    case 20:
+    case 21:
+        return FunctionKeys[code - 12];
+    case 23:
+    case 24:
+        return FunctionKeys[code - 13];
+    }
+    return e172::ScancodeUnknown;
+}
+
+/// Keys identified by final byte of CSI and SS3 sequences
+e172::Scancode finalKey(e172::Byte final)
+{
+    switch (final) {
+    case 'A':
+        return e172::ScancodeUp;
+    case 'B':
+        return e172::ScancodeDown;
+    case 'C':
+        return e172::ScancodeRight;
+    case 'D':
+        return e172::ScancodeLeft;
+    case 'H':
+        return e172::ScancodeHome;
+    case 'F':
+        return e172::ScancodeEnd;
+    case 'P':
+        return e172::ScancodeF1;
+    case 'Q':
+        return e172::ScancodeF2;
+    case 'R':
+        return e172::ScancodeF3;
+    case 'S':
+        return e172::ScancodeF4;
+    case 'M':
+        /// SS3 keypad Enter
+        return e172::ScancodeReturn;
+    }
+    return e172::ScancodeUnknown;
+}
+
+/// Keys of kitty `CSI code u` sequences outside of ASCII
+e172::Scancode kittyKey(std::uint32_t code)
+{
+    switch (code) {
+    case 57414:
+        /// keypad Enter
+        return e172::ScancodeReturn;
+    case 57441:
+        return e172::ScancodeLShift;
+    case 57442:
+        return e172::ScancodeLCtrl;
+    case 57443:
+        return e172::ScancodeLAlt;
+    case 57447:
+        return e172::ScancodeRShift;
+    case 57448:
+        return e172::ScancodeRCtrl;
+    case 57449:
+        return e172::ScancodeRAlt;
+    }
+    return e172::ScancodeUnknown;
+}
+
+/// Signal terminal generates for Ctrl + `code` in legacy input or 0
+int keySignal(std::uint32_t code)
+{
+    switch (code) {
+    case 'c':
+        return SIGINT;
+    case '\\':
+        return SIGQUIT;
+    case 'z':
+        return SIGTSTP;
+    }
+    return 0;
+}
+
+/// Flag of kitty keyboard protocol
+constexpr std::uint32_t KittyReportEventTypes = 2;
+
+} // namespace
+
+const std::array<InputParser::ByteClass, 256> InputParser::ByteClasses = [] {
+    std::array<ByteClass, 256> classes = {};
+    for (std::size_t i = 0; i < classes.size(); ++i) {
+        if (i < 0x20) {
+            classes[i] = ByteClass::Control;
+        } else if (i < 0x30) {
+            classes[i] = ByteClass::Intermediate;
+        } else if (i < 0x40) {
+            classes[i] = ByteClass::Param;
+        } else if (i < 0x7F) {
+            classes[i] = ByteClass::Final;
+        } else if (i == 0x7F) {
+            classes[i] = ByteClass::Del;
+        } else {
+            classes[i] = ByteClass::High;
+        }
+    }
+    classes[0x1B] = ByteClass::Esc;
+    classes['['] = ByteClass::CsiIntroducer;
+    classes['O'] = ByteClass::Ss3Introducer;
+    return classes;
+}();
+
+/// Columns are ordered as ByteClass:
+/// Control, Esc, Intermediate, Param, CsiIntroducer, Ss3Introducer, Final, Del, High
+const InputParser::Transition InputParser::Transitions[std::size_t(
+    State::StateCount)][std::size_t(ByteClass::ClassCount)] = {
+    /// Ground
+    {{Action::Print, State::Ground},
+     {Action::None, State::Escape},
+     {Action::Print, State::Ground},
+     {Action::Print, State::Ground},
+     {Action::Print, State::Ground},
+     {Action::Print, State::Ground},
+     {Action::Print, State::Ground},
+     {Action::Print, State::Ground},
+     {Action::None, State::Ground}},
+    /// Escape. Second ESC means the first one was Escape key
+    {{Action::AltPrint, State::Ground},
+     {Action::EscapeKey, State::Escape},
+     {Action::AltPrint, State::Ground},
+     {Action::AltPrint, State::Ground},
+     {Action::Clear, State::Csi},
+     {Action::Clear, State::Ss3},
+     {Action::AltPrint, State::Ground},
+     {Action::AltPrint, State::Ground},
+     {Action::None, State::Ground}},
+    /// Csi. Controls inside of sequence are executed, ESC cancels it
+    {{Action::Print, State::Csi},
+     {Action::None, State::Escape},
+     {Action::Collect, State::Csi},
+     {Action::Param, State::Csi},
+     {Action::CsiDispatch, State::Ground},
+     {Action::CsiDispatch, State::Ground},
+     {Action::CsiDispatch, State::Ground},
+     {Action::None, State::Csi},
+     {Action::None, State::Ground}},
+    /// Ss3
+    {{Action::Print, State::Ground},
+     {Action::None, State::Escape},
+     {Action::None, State::Ss3},
+     {Action::Param, State::Ss3},
+     {Action::Ss3Dispatch, State::Ground},
+     {Action::Ss3Dispatch, State::Ground},
+     {Action::Ss3Dispatch, State::Ground},
+     {Action::None, State::Ground},
+     {Action::None, State::Ground}},
+    /// Paste is handled by feedPaste
+    {{Action::None, State::Paste},
+     {Action::None, State::Paste},
+     {Action::None, State::Paste},
+     {Action::None, State::Paste},
+     {Action::None, State::Paste},
+     {Action::None, State::Paste},
+     {Action::None, State::Paste},
+     {Action::None, State::Paste},
+     {Action::None, State::Paste}},
+};
+
+void InputParser::feed(std::span<const Byte> bytes, std::vector<Input> &events)
+{
+    for (const auto byte : bytes) {
+        if (m_state == State::Paste) {
+            feedPaste(byte, events);
+            continue;
+        }
+
+        const auto &transition
+            = Transitions[std::size_t(m_state)][std::size_t(ByteClasses[byte])];
+        /// set before dispatch, which may switch to paste
+        m_state = transition.next;
+        switch (transition.action) {
+        case Action::None:
+            break;
+        case Action::Print:
+            emitByte(byte, 0, events);
+            break;
+        case Action::AltPrint:
+            emitByte(byte, Alt, events);
+            break;
+        case Action::EscapeKey:
+            emitKey(e172::ScancodeEscape, 0, events);
+            break;
+        case Action::Clear:
+            m_params = {};
+            m_subParams = {};
+            m_paramCount = 0;
+            m_subIndex = 0;
+            m_marker = 0;
+            m_intermediate = 0;
+            break;
+        case Action::Collect:
+            m_intermediate = byte;
+            break;
+        case Action::Param:
+            if (byte >= '0' && byte <= '9') {
+                if (m_paramCount == 0) {
+                    m_paramCount = 1;
+                }
+                if (m_subIndex > 1) {
+                    break;
+                }
+                auto &param = (m_subIndex == 0 ? m_params : m_subParams)[m_paramCount - 1];
+                if (param < std::numeric_limits<std::uint32_t>::max() / 10) {
+                    param = param * 10 + (byte - '0');
+                }
+            } else if (byte == ';') {
+                if (m_paramCount == 0) {
+                    m_paramCount = 1;
+                }
+                if (m_paramCount < MaxParams) {
+                    ++m_paramCount;
+                }
+                m_subIndex = 0;
+            } else if (byte == ':') {
+                if (m_paramCount == 0) {
+                    m_paramCount = 1;
+                }
+                ++m_subIndex;
+            } else {
+                m_marker = byte;
+            }
+            break;
+        case Action::CsiDispatch:
+            dispatchCsi(byte, events);
+            break;
+        case Action::Ss3Dispatch:
+            dispatchSs3(byte, events);
+            break;
+        }
+    }
+}
+
+bool InputParser::pending() const
+{
+    const bool empty = m_paramCount == 0 && m_marker == 0 && m_intermediate == 0;
+    return m_state == State::Escape
+           || ((m_state == State::Csi || m_state == State::Ss3) && empty);
+}
+
+void InputParser::flush(std::vector<Input> &events)
+{
+    if (!pending()) {
+        return;
+    }
+    if (m_state == State::Escape) {
+        emitKey(e172::ScancodeEscape, 0, events);
+    } else {
+        emitByte(m_state == State::Csi ? '[' : 'O', Alt, events);
+    }
+    m_state = State::Ground;
+}
+
+void InputParser::feedPaste(Byte byte, std::vector<Input> &events)
+{
+    if (byte == PasteTerminator[m_pasteMatch]) {
+        if (++m_pasteMatch == std::size(PasteTerminator)) {
+            m_pasteMatch = 0;
+            m_state = State::Ground;
+        }
+        return;
+    }
+
+    /// terminator starts with the only ESC in it, so mismatched prefix is plain text
+    for (std::size_t i = 0; i < m_pasteMatch; ++i) {
+        emitByte(PasteTerminator[i], 0, events);
+    }
+    m_pasteMatch = byte == PasteTerminator[0] ? 1 : 0;
+    if (m_pasteMatch == 0) {
+        emitByte(byte, 0, events);
+    }
+}
+
+void InputParser::dispatchCsi(Byte final, std::vector<Input> &events)
+{
+    if (m_marker == '<' && m_intermediate == 0 && (final == 'M' || final == 'm')) {
+        dispatchMouse(final, events);
+        return;
+    }
+    if (m_marker == '?' && m_intermediate == 0 && final == 'u') {
+        /// reply to query of kitty keyboard flags
+        m_keyEvents = m_paramCount > 0 && (m_params[0] & KittyReportEventTypes) != 0;
+        return;
+    }
+    if (m_marker != 0 || m_intermediate != 0) {
+        return;
+    }
+
+    if (final == '~') {
+        const auto code = m_paramCount > 0 ? m_params[0] : 0;
+        if (code == 200) {
+            m_state = State::Paste;
+            m_pasteMatch = 0;
+        } else if (const auto key = tildeKey(code); key != e172::ScancodeUnknown) {
+            emitKey(key, parameterModifiers(1), events, keyEvent());
+        }
+    } else if (final == 'u') {
+        dispatchKittyKey(events);
+    } else if (final == 'Z') {
+        emitKey(e172::ScancodeTab, Shift, events);
+    } else if (const auto key = finalKey(final); key != e172::ScancodeUnknown) {
+        emitKey(key, parameterModifiers(1), events, keyEvent());
+    }
+}
+
+void InputParser::dispatchSs3(Byte final, std::vector<Input> &events)
+{
+    if (const auto key = finalKey(final); key != e172::ScancodeUnknown) {
+        /// some terminals send modifiers of SS3 keys as the only parameter
+        emitKey(key, parameterModifiers(m_paramCount > 1 ? 1 : 0), events);
+    }
+}
+
+void InputParser::dispatchMouse(Byte final, std::vector<Input> &events)
+{
+    if (m_paramCount < 3 || m_params[1] == 0 || m_params[2] == 0) {
+        return;
+    }
+
+    /// button code: low bits - button, 4 - shift, 8 - alt, 16 - ctrl, 32 - motion, 64 - wheel
+    const auto code = m_params[0];
+    MouseEvent event{.kind = MouseEvent::Press,
+                     .button = std::uint8_t(code & 0b11),
+                     .modifiers = std::uint8_t(((code & 4) ? Shift : 0) | ((code & 8) ? Alt : 0)
+                                               | ((code & 16) ? Ctrl : 0)),
+                     .column = m_params[1] - 1,
+                     .row = m_params[2] - 1};
+    if (code & 64) {
+        event.kind = MouseEvent::Wheel;
+    } else if (code & 32) {
+        event.kind = MouseEvent::Motion;
+    } else if (final == 'm') {
+        event.kind = MouseEvent::Release;
+    }
+
+    if (event.kind == MouseEvent::Motion && !events.empty()) {
+        if (const auto last = std::get_if<MouseEvent>(&events.back());
+            last && last->kind == MouseEvent::Motion && last->button == event.button
+            && last->modifiers == event.modifiers) {
+            *last = event;
+            return;
+        }
+    }
+    events.push_back(event);
+}
+
+void InputParser::dispatchKittyKey(std::vector<Input> &events)
+{
+    /// code is of unshifted key, so modifiers are taken from parameter only
+    const auto code = m_paramCount > 0 ? m_params[0] : 0;
+    const auto modifiers = parameterModifiers(1);
+    const auto type = keyEvent();
+    if (const auto signal = keySignal(code); m_signalKeys && signal != 0 && modifiers == Ctrl) {
+        /// like in legacy input the key is consumed by signal, its release included
+        if (type == KeyEvent::Tap || type == KeyEvent::Press) {
+            m_signals.push_back(signal);
+        }
+        return;
+    }
+    const auto key = code < AsciiKeys.size() ? AsciiKeys[code].scancode : kittyKey(code);
+    emitKey(key, modifiers, events, type);
+}
+
+InputParser::KeyEvent InputParser::keyEvent() const
+{
+    if (!m_keyEvents) {
+        return KeyEvent::Tap;
+    }
+    switch (m_paramCount > 1 ? m_subParams[1] : 0) {
+    case 2:
+        return KeyEvent::Repeat;
+    case 3:
+        return KeyEvent::Release;
+    }
+    return KeyEvent::Press;
+}
+
+std::uint8_t InputParser::parameterModifiers(std::size_t index) const
+{
+    const auto value = index < m_paramCount ? m_params[index] : 0;
+    return value > 1 ? (value - 1) & (Shift | Alt | Ctrl) : 0;
+}
+
+void InputParser::emitByte(Byte byte, std::uint8_t modifiers, std::vector<Input> &events)
+{
+    if (byte < AsciiKeys.size()) {
+        const auto &key = AsciiKeys[byte];
+        emitKey(key.scancode, key.modifiers | modifiers, events);
+    }
+}
+
+void InputParser::emitKey(e172::Scancode scancode,
+                          std::uint8_t modifiers,
+                          std::vector<Input> &events,
+                          KeyEvent type)
+{
+    if (scancode == e172::ScancodeUnknown) {
+        return;
+    }
+    /// modifier keys have their own presses and releases in kitty protocol
+    switch (type) {
+    case KeyEvent::Tap:
+        break;
+    case KeyEvent::Press:
+        events.push_back(e172::Event::keyDown(scancode));
+        return;
+    case KeyEvent::Repeat:
+        return;
+    case KeyEvent::Release:
+        events.push_back(e172::Event::keyUp(scancode));
+        return;
+    }
+    if (modifiers & Ctrl) {
+        events.push_back(e172::Event::keyDown(e172::ScancodeLCtrl));
+    }
+    if (modifiers & Alt) {
+        events.push_back(e172::Event::keyDown(e172::ScancodeLAlt));
+    }
+    if (modifiers & Shift) {
+        events.push_back(e172::Event::keyDown(e172::ScancodeLShift));
+    }
+    events.push_back(e172::Event::keyDown(scancode));
+    events.push_back(e172::Event::keyUp(scancode));
+    if (modifiers & Shift) {
+        events.push_back(e172::Event::keyUp(e172::ScancodeLShift));
+    }
+    if (modifiers & Alt) {
+        events.push_back(e172::Event::keyUp(e172::ScancodeLAlt));
+    }
+    if (modifiers & Ctrl) {
+        events.push_back(e172::Event::keyUp(e172::ScancodeLCtrl));
+    }
+}
+
+} // namespace e172::impl::console
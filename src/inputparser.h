@@ -0,0 +1,161 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <e172/abstracteventprovider.h>
+#include <span>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace e172::impl::console {
+
+/// Mouse report of SGR (1006) mouse protocol
+struct MouseEvent
+{
+    enum Kind : std::uint8_t { Press, Release, Motion, Wheel };
+    enum Button : std::uint8_t { Left, Middle, Right, NoButton };
+    enum WheelDirection : std::uint8_t { WheelUp, WheelDown, WheelLeft, WheelRight };
+
+    Kind kind;
+    /// Button for presses, releases and motion (held button or NoButton),
+    /// WheelDirection for wheel
+    std::uint8_t button;
+    /// InputParser::Modifier bits
+    std::uint8_t modifiers;
+    /// zero based cell
+    std::uint32_t column;
+    std::uint32_t row;
+};
+
+/// Incremental parser of VT/xterm terminal input. State is kept between calls of feed(),
+/// so sequences split across reads are decoded. Every byte is looked at once; unknown
+/// sequences are skipped and never abort parsing.
+/// Decoded keys: printable ASCII, C0 controls (as Ctrl + key), Alt (ESC prefix), CSI and
+/// SS3 cursor, editing and function keys with xterm modifier parameter, bracketed paste
+/// (pasted text is reported as typed keys), SGR mouse reports. Modifiers are reported as
+/// presses of left modifier keys around the key.
+/// Once terminal confirms kitty keyboard protocol with event types (reply to query in
+/// KittyKeyboardEnable), keys are reported as real presses and releases, modifier keys
+/// included, and autorepeat is dropped since key stays held until its release.
+/// Mouse motion reports following each other are coalesced into the last one
+class InputParser
+{
+public:
+    /// Bits of xterm modifier parameter (its value minus one)
+    enum Modifier : std::uint8_t { Shift = 1, Alt = 2, Ctrl = 4 };
+
+    using Input = std::variant<e172::Event, MouseEvent>;
+
+    /// Feeds next bytes. Decoded input is appended to `events`. Motion is coalesced with
+    /// motion at the end of `events`, so caller decides the window by clearing it
+    void feed(std::span<const e172::Byte> bytes, std::vector<Input> &events);
+
+    /// True if input ended right after ESC, ESC [ or ESC O. It is either a key press
+    /// (Escape, Alt + [, Alt + O) or beginning of a sequence whose rest has not arrived yet,
+    /// so caller should wait for EscapeTimeoutMs and then call flush()
+    bool pending() const;
+
+    /// Reports pending input as key press
+    void flush(std::vector<Input> &events);
+
+    /// In kitty protocol terminal reports Ctrl+C, Ctrl+\ and Ctrl+Z as keys instead of sending
+    /// SIGINT, SIGQUIT and SIGTSTP. If set, such presses are not decoded as keys but collected,
+    /// so caller can raise the signals
+    void setSignalKeys(bool value) { m_signalKeys = value; }
+
+    /// Signals of keys pressed since previous call, in order of presses (see setSignalKeys)
+    std::vector<int> takeSignals() { return std::exchange(m_signals, {}); }
+
+    static constexpr auto EscapeTimeoutMs = 25;
+
+    /// Sent by terminal around pasted text once enabled with BracketedPasteEnable
+    static constexpr const char *BracketedPasteEnable = "\x1b[?2004h";
+    static constexpr const char *BracketedPasteDisable = "\x1b[?2004l";
+    /// Reports of all motion (1003) in SGR encoding (1006)
+    static constexpr const char *MouseEnable = "\x1b[?1003h\x1b[?1006h";
+    static constexpr const char *MouseDisable = "\x1b[?1006l\x1b[?1003l";
+    /// Pushes kitty keyboard flags: disambiguate (1), report event types (2), report all
+    /// keys as escape codes (8) and queries them. Terminals without the protocol ignore both
+    static constexpr const char *KittyKeyboardEnable = "\x1b[>11u\x1b[?u";
+    static constexpr const char *KittyKeyboardDisable = "\x1b[<u";
+
+private:
+    enum class State : std::uint8_t { Ground, Escape, Csi, Ss3, Paste, StateCount };
+
+    /// Byte classes. Bytes of one class take the same transition in every state
+    enum class ByteClass : std::uint8_t {
+        Control,
+        Esc,
+        Intermediate,
+        Param,
+        CsiIntroducer,
+        Ss3Introducer,
+        Final,
+        Del,
+        High,
+        ClassCount
+    };
+
+    enum class Action : std::uint8_t {
+        None,
+        Print,
+        AltPrint,
+        Clear,
+        Collect,
+        Param,
+        CsiDispatch,
+        Ss3Dispatch,
+        EscapeKey
+    };
+
+    /// Press and release reported together (legacy input) or separately (kitty protocol)
+    enum class KeyEvent : std::uint8_t { Tap, Press, Repeat, Release };
+
+    struct Transition
+    {
+        Action action;
+        State next;
+    };
+
+    static const std::array<ByteClass, 256> ByteClasses;
+    static const Transition Transitions[std::size_t(State::StateCount)]
+                                       [std::size_t(ByteClass::ClassCount)];
+
+    void feedPaste(e172::Byte byte, std::vector<Input> &events);
+    void dispatchCsi(e172::Byte final, std::vector<Input> &events);
+    void dispatchSs3(e172::Byte final, std::vector<Input> &events);
+    void dispatchMouse(e172::Byte final, std::vector<Input> &events);
+    void dispatchKittyKey(std::vector<Input> &events);
+    static void emitByte(e172::Byte byte, std::uint8_t modifiers, std::vector<Input> &events);
+    static void emitKey(e172::Scancode scancode,
+                        std::uint8_t modifiers,
+                        std::vector<Input> &events,
+                        KeyEvent type = KeyEvent::Tap);
+    /// Kind of key event of CSI sequence, encoded as sub-parameter of its modifiers
+    KeyEvent keyEvent() const;
+    /// Modifiers encoded as xterm parameter (1 + bitmask)
+    std::uint8_t parameterModifiers(std::size_t index) const;
+
+private:
+    static constexpr std::size_t MaxParams = 16;
+
+    State m_state = State::Ground;
+    std::array<std::uint32_t, MaxParams> m_params = {};
+    std::size_t m_paramCount = 0;
+    /// first sub-parameter (after ':') of each parameter
+    std::array<std::uint32_t, MaxParams> m_subParams = {};
+    /// 0 while main value of current parameter is read
+    std::size_t m_subIndex = 0;
+    /// private marker ('<', '=', '>', '?') or intermediate byte of current CSI, 0 if none
+    e172::Byte m_marker = 0;
+    e172::Byte m_intermediate = 0;
+    /// bytes of paste terminator matched so far
+    std::size_t m_pasteMatch = 0;
+    /// set once terminal confirms kitty keyboard protocol reporting event types
+    bool m_keyEvents = false;
+    bool m_signalKeys = false;
+    std::vector<int> m_signals;
+};
+
+} // namespace e172::impl::console
@@ -0,0 +1,90 @@
+#include "latency.h"
+
+#include <bit>
+
+namespace e172::impl::console {
+
+LatencyTracker::Clock::duration LatencyTracker::Stats::mean() const
+{
+    return count > 0 ? total / std::int64_t(count) : Clock::duration::zero();
+}
+
+LatencyTracker::Clock::duration LatencyTracker::Stats::percentile(double fraction) const
+{
+    if (count == 0) {
+        return Clock::duration::zero();
+    }
+    const auto target = static_cast<std::size_t>(fraction * double(count));
+    std::size_t seen = 0;
+    for (std::size_t i = 0; i < histogram.size(); ++i) {
+        seen += histogram[i];
+        if (seen > target) {
+            return std::min<Clock::duration>(std::chrono::microseconds(std::uint64_t(1) << i),
+                                             max);
+        }
+    }
+    return max;
+}
+
+void LatencyTracker::eventPulled(Clock::time_point readAt)
+{
+    std::lock_guard lock(m_mutex);
+    m_pending.push_back(readAt);
+}
+
+void LatencyTracker::frameWritten(Clock::time_point writtenAt)
+{
+    std::lock_guard lock(m_mutex);
+    for (const auto readAt : m_pending) {
+        const auto latency = writtenAt - readAt;
+        ++m_stats.count;
+        m_stats.min = std::min(m_stats.min, latency);
+        m_stats.max = std::max(m_stats.max, latency);
+        m_stats.total += latency;
+        ++m_stats.histogram[histogramBucket(latency)];
+    }
+    m_pending.clear();
+}
+
+LatencyTracker::Stats LatencyTracker::stats() const
+{
+    std::lock_guard lock(m_mutex);
+    return m_stats;
+}
+
+void LatencyTracker::reset()
+{
+    std::lock_guard lock(m_mutex);
+    m_stats = {};
+}
+
+std::size_t LatencyTracker::histogramBucket(Clock::duration latency)
+{
+    const auto us = std::chrono::duration_cast<std::chrono::microseconds>(latency).count();
+    return std::min<std::size_t>(std::bit_width(std::uint64_t(std::max<decltype(us)>(us, 0))),
+                                 HistogramBuckets - 1);
+}
+
+std::ostream &operator<<(std::ostream &stream, const LatencyTracker::Stats &stats)
+{
+    using std::chrono::microseconds;
+    const auto us = [](LatencyTracker::Clock::duration d) {
+        return std::chrono::duration_cast<microseconds>(d).count();
+    };
+    stream << "input latency: " << stats.count << " events";
+    if (stats.count == 0) {
+        return stream << '\n';
+    }
+    stream << ", min " << us(stats.min) << " us, mean " << us(stats.mean()) << " us, p50 <= "
+           << us(stats.percentile(0.5)) << " us, p99 <= " << us(stats.percentile(0.99))
+           << " us, max " << us(stats.max) << " us\n";
+    for (std::size_t i = 0; i < stats.histogram.size(); ++i) {
+        if (stats.histogram[i] > 0) {
+            const auto from = i == 0 ? 0 : std::uint64_t(1) << (i - 1);
+            stream << "  >= " << from << " us: " << stats.histogram[i] << '\n';
+        }
+    }
+    return stream;
+}
+
+} // namespace e172::impl::console
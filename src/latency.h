@@ -0,0 +1,59 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+namespace e172::impl::console {
+
+/// Input-to-photon latency: time from reading an event from stdin to finishing the write of
+/// the first frame rendered after the event was pulled. EventProvider reports pulled
+/// events and Writer reports written frames; each event gives one sample. Thread safe
+class LatencyTracker
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /// bucket i counts samples of [2^(i-1), 2^i) microseconds, the last one also everything
+    /// longer
+    static constexpr std::size_t HistogramBuckets = 32;
+
+    struct Stats
+    {
+        std::size_t count = 0;
+        Clock::duration min = Clock::duration::max();
+        Clock::duration max = Clock::duration::zero();
+        Clock::duration total = Clock::duration::zero();
+        std::array<std::size_t, HistogramBuckets> histogram = {};
+
+        Clock::duration mean() const;
+        /// Upper bound of histogram bucket containing `fraction` (0..1) of samples
+        Clock::duration percentile(double fraction) const;
+    };
+
+    /// Event read at `readAt` was pulled by game
+    void eventPulled(Clock::time_point readAt);
+
+    /// Frame was written out at `writtenAt`. Every event pulled before gives a sample
+    void frameWritten(Clock::time_point writtenAt);
+
+    Stats stats() const;
+    void reset();
+
+private:
+    static std::size_t histogramBucket(Clock::duration latency);
+
+private:
+    mutable std::mutex m_mutex;
+    /// read time of events pulled since last frame
+    std::vector<Clock::time_point> m_pending;
+    Stats m_stats;
+};
+
+/// Human readable report for profiling logs
+std::ostream &operator<<(std::ostream &stream, const LatencyTracker::Stats &stats);
+
+} // namespace e172::impl::console
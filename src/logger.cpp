@@ -0,0 +1,114 @@
+#include "logger.h"
+
+#include <iomanip>
+
+namespace e172::impl::console {
+
+namespace {
+
+const char *levelName(LogLevel level)
+{
+    switch (level) {
+    case LogLevel::Trace:
+        return "trace";
+    case LogLevel::Debug:
+        return "debug";
+    case LogLevel::Info:
+        return "info";
+    case LogLevel::Warning:
+        return "warning";
+    case LogLevel::Error:
+        return "error";
+    case LogLevel::Off:
+        break;
+    }
+    return "off";
+}
+
+} // namespace
+
+Logger::Logger(std::ostream &output, LogLevel level)
+    : m_output(output)
+    , m_level(level)
+    , m_start(Clock::now())
+    , m_records(std::make_unique<Record[]>(Capacity))
+{
+    static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+    for (std::size_t i = 0; i < Capacity; ++i) {
+        m_records[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    m_writer = std::thread([this] { run(); });
+}
+
+Logger::~Logger()
+{
+    m_stopping.store(true, std::memory_order_relaxed);
+    m_signal.fetch_add(1, std::memory_order_release);
+    m_signal.notify_one();
+    m_writer.join();
+}
+
+void Logger::push(LogLevel level, std::string text)
+{
+    auto pos = m_head.load(std::memory_order_relaxed);
+    Record *record;
+    while (true) {
+        record = &m_records[pos & (Capacity - 1)];
+        const auto sequence = record->sequence.load(std::memory_order_acquire);
+        const auto diff = std::ptrdiff_t(sequence) - std::ptrdiff_t(pos);
+        if (diff == 0) {
+            if (m_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            /// slot is not written out yet since previous lap
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        } else {
+            pos = m_head.load(std::memory_order_relaxed);
+        }
+    }
+
+    record->level = level;
+    record->time = Clock::now();
+    record->text = std::move(text);
+    record->sequence.store(pos + 1, std::memory_order_release);
+
+    m_signal.fetch_add(1, std::memory_order_release);
+    m_signal.notify_one();
+}
+
+void Logger::run()
+{
+    while (true) {
+        const auto signal = m_signal.load(std::memory_order_acquire);
+        bool written = false;
+        while (true) {
+            auto &record = m_records[m_tail & (Capacity - 1)];
+            if (record.sequence.load(std::memory_order_acquire) != m_tail + 1) {
+                break;
+            }
+            const auto seconds = std::chrono::duration<double>(record.time - m_start).count();
+            m_output << '[' << std::fixed << std::setprecision(6) << std::setw(12) << seconds
+                     << "] " << levelName(record.level) << ": " << record.text << '\n';
+            record.text.clear();
+            record.sequence.store(m_tail + Capacity, std::memory_order_release);
+            ++m_tail;
+            written = true;
+        }
+        /// one flush per batch instead of one per line
+        if (written) {
+            m_output.flush();
+        }
+        if (m_stopping.load(std::memory_order_relaxed)) {
+            break;
+        }
+        m_signal.wait(signal, std::memory_order_acquire);
+    }
+
+    if (const auto lost = dropped()) {
+        m_output << "logger: " << lost << " messages dropped" << std::endl;
+    }
+}
+
+} // namespace e172::impl::console
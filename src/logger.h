@@ -0,0 +1,120 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#ifndef E172_CONSOLE_LOG_LEVEL
+/// Messages below this level are compiled out: 0 - trace, 1 - debug, 2 - info, 3 - warning,
+/// 4 - error, 5 - nothing is logged
+#define E172_CONSOLE_LOG_LEVEL 0
+#endif
+
+namespace e172::impl::console {
+
+enum class LogLevel : std::uint8_t { Trace, Debug, Info, Warning, Error, Off };
+
+/// Leveled log written to a stream by a background thread. Logging threads only format a
+/// message and put it into a lock-free queue, so they never wait for the stream.
+/// Messages are dropped (and counted) while the queue is full
+class Logger
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr LogLevel CompiledLevel = LogLevel(E172_CONSOLE_LOG_LEVEL);
+    static constexpr std::size_t Capacity = 4096;
+
+    Logger(std::ostream &output, LogLevel level = LogLevel::Info);
+    ~Logger();
+
+    LogLevel level() const { return m_level.load(std::memory_order_relaxed); }
+    void setLevel(LogLevel level) { m_level.store(level, std::memory_order_relaxed); }
+
+    /// Constant false for levels compiled out, so code guarded by it is removed too.
+    /// Use it to skip building expensive arguments
+    bool enabled(LogLevel level) const
+    {
+        return level >= CompiledLevel && level != LogLevel::Off && level >= this->level();
+    }
+
+    template<typename... Args>
+    void log(LogLevel level, const Args &...args)
+    {
+        if (!enabled(level)) {
+            return;
+        }
+        thread_local std::ostringstream stream;
+        stream.str({});
+        (stream << ... << args);
+        push(level, stream.str());
+    }
+
+    template<typename... Args>
+    void trace(const Args &...args)
+    {
+        log(LogLevel::Trace, args...);
+    }
+
+    template<typename... Args>
+    void debug(const Args &...args)
+    {
+        log(LogLevel::Debug, args...);
+    }
+
+    template<typename... Args>
+    void info(const Args &...args)
+    {
+        log(LogLevel::Info, args...);
+    }
+
+    template<typename... Args>
+    void warning(const Args &...args)
+    {
+        log(LogLevel::Warning, args...);
+    }
+
+    template<typename... Args>
+    void error(const Args &...args)
+    {
+        log(LogLevel::Error, args...);
+    }
+
+    /// Count of messages lost because writer did not keep up
+    std::size_t dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+private:
+    /// Slot of bounded multi-producer queue. `sequence` tells whose turn it is:
+    /// equal to position - free for producer, position + 1 - filled for writer
+    struct Record
+    {
+        std::atomic<std::size_t> sequence;
+        LogLevel level;
+        Clock::time_point time;
+        std::string text;
+    };
+
+    void push(LogLevel level, std::string text);
+    void run();
+
+private:
+    std::ostream &m_output;
+    std::atomic<LogLevel> m_level;
+    const Clock::time_point m_start;
+    std::unique_ptr<Record[]> m_records;
+    alignas(64) std::atomic<std::size_t> m_head = 0;
+    /// used by writer thread only
+    alignas(64) std::size_t m_tail = 0;
+    /// bumped after each push to wake writer
+    std::atomic<std::uint32_t> m_signal = 0;
+    std::atomic<std::size_t> m_dropped = 0;
+    std::atomic<bool> m_stopping = false;
+    std::thread m_writer;
+};
+
+} // namespace e172::impl::console
@@ -2,9 +2,86 @@
 
 #include <algorithm>
 #include <math.h>
+#include <utility>
 
 namespace e172::impl::console::pixel_primitives {
 
+namespace {
+
+constexpr unsigned ReciprocalShift = 48;
+
+/// (a * inv) >> ReciprocalShift == a / n for all sums a of n channel values while
+/// 255 * n * n < 2^48, i.e. n < 2^20 (blur radius is clamped to the area, so it holds)
+inline std::uint64_t reciprocal(std::size_t n)
+{
+    return ((std::uint64_t(1) << ReciprocalShift) + n - 1) / n;
+}
+
+inline std::uint32_t divide(std::uint32_t sum, std::uint64_t inv)
+{
+    return std::min<std::uint32_t>((std::uint64_t(sum) * inv) >> ReciprocalShift, 0xff);
+}
+
+inline std::size_t clamp_index(std::int64_t i, std::size_t len)
+{
+    return i < 0 ? 0 : (std::size_t(i) >= len ? len - 1 : std::size_t(i));
+}
+
+/// running sum over one line of a channel plane. `padded` is scratch of len + 2 * radius + 1 elements
+void blur_line(const std::uint32_t *src,
+               std::uint32_t *dst,
+               std::uint32_t *padded,
+               std::size_t len,
+               std::size_t radius)
+{
+    const auto inv = reciprocal(2 * radius + 1);
+    std::fill(padded, padded + radius, src[0]);
+    std::copy(src, src + len, padded + radius);
+    std::fill(padded + radius + len, padded + 2 * radius + len + 1, src[len - 1]);
+
+    std::uint32_t acc = 0;
+    for (std::size_t k = 0; k <= 2 * radius; ++k) {
+        acc += padded[k];
+    }
+    for (std::size_t i = 0; i < len; ++i) {
+        dst[i] = divide(acc, inv);
+        acc += padded[i + 2 * radius + 1];
+        acc -= padded[i];
+    }
+}
+
+/// running sum over all columns of a channel plane at once. inner loops go along rows and vectorize
+void blur_columns(const std::uint32_t *src,
+                  std::uint32_t *dst,
+                  std::uint32_t *acc,
+                  std::size_t w,
+                  std::size_t h,
+                  std::size_t radius)
+{
+    const auto r = std::int64_t(radius);
+    const auto inv = reciprocal(2 * radius + 1);
+    std::fill(acc, acc + w, 0);
+    for (std::int64_t k = -r; k <= r; ++k) {
+        const auto row = src + clamp_index(k, h) * w;
+        for (std::size_t x = 0; x < w; ++x) {
+            acc[x] += row[x];
+        }
+    }
+    for (std::int64_t y = 0; y < std::int64_t(h); ++y) {
+        const auto out = dst + y * w;
+        for (std::size_t x = 0; x < w; ++x) {
+            out[x] = divide(acc[x], inv);
+        }
+        const auto add = src + clamp_index(y + r + 1, h) * w;
+        const auto sub = src + clamp_index(y - r, h) * w;
+        for (std::size_t x = 0; x < w; ++x) {
+            acc[x] += add[x] - sub[x];
+        }
+    }
+}
+
+} // namespace
+
 void draw_line(bitmap &btmp,
                std::int64_t point0_x,
                std::int64_t point0_y,
@@ -83,6 +160,104 @@ void draw_line(bitmap &btmp,
     }
 }
 
+bool clip_line(const bitmap &btmp,
+               std::int64_t &point0_x,
+               std::int64_t &point0_y,
+               std::int64_t &point1_x,
+               std::int64_t &point1_y)
+{
+    if (!btmp || btmp.width == 0 || btmp.height == 0) {
+        return false;
+    }
+    const double max_x = btmp.width - 1;
+    const double max_y = btmp.height - 1;
+    const double dx = point1_x - point0_x;
+    const double dy = point1_y - point0_y;
+
+    /// Liang-Barsky
+    double t0 = 0;
+    double t1 = 1;
+    const auto clip = [&t0, &t1](double p, double q) {
+        if (p == 0) {
+            return q >= 0;
+        }
+        const auto t = q / p;
+        if (p < 0) {
+            if (t > t1)
+                return false;
+            t0 = std::max(t0, t);
+        } else {
+            if (t < t0)
+                return false;
+            t1 = std::min(t1, t);
+        }
+        return true;
+    };
+
+    if (!clip(-dx, point0_x) || !clip(dx, max_x - point0_x) || !clip(-dy, point0_y)
+        || !clip(dy, max_y - point0_y)) {
+        return false;
+    }
+
+    const auto x0 = point0_x;
+    const auto y0 = point0_y;
+    point0_x = std::clamp<std::int64_t>(std::llround(x0 + t0 * dx), 0, max_x);
+    point0_y = std::clamp<std::int64_t>(std::llround(y0 + t0 * dy), 0, max_y);
+    point1_x = std::clamp<std::int64_t>(std::llround(x0 + t1 * dx), 0, max_x);
+    point1_y = std::clamp<std::int64_t>(std::llround(y0 + t1 * dy), 0, max_y);
+    return true;
+}
+
+void draw_line_clipped(bitmap &btmp,
+                       std::int64_t point0_x,
+                       std::int64_t point0_y,
+                       std::int64_t point1_x,
+                       std::int64_t point1_y,
+                       e172::Color argb)
+{
+    if (!clip_line(btmp, point0_x, point0_y, point1_x, point1_y)) {
+        return;
+    }
+
+    const auto dx = std::abs(point1_x - point0_x);
+    const auto dy = -std::abs(point1_y - point0_y);
+    const std::int64_t sx = point0_x < point1_x ? 1 : -1;
+    const std::int64_t sy = point0_y < point1_y ? std::int64_t(btmp.width) : -std::int64_t(btmp.width);
+    auto ptr = btmp.matrix + point0_y * btmp.width + point0_x;
+    auto err = dx + dy;
+    for (auto n = std::max(dx, -dy); n >= 0; --n) {
+        *ptr = argb;
+        const auto e2 = 2 * err;
+        if (e2 >= dy) {
+            err += dy;
+            ptr += sx;
+        }
+        if (e2 <= dx) {
+            err += dx;
+            ptr += sy;
+        }
+    }
+}
+
+void fill_rect(bitmap &btmp,
+               std::int64_t point0_x,
+               std::int64_t point0_y,
+               std::int64_t point1_x,
+               std::int64_t point1_y,
+               e172::Color argb)
+{
+    const auto x0 = std::clamp<std::int64_t>(std::min(point0_x, point1_x), 0, btmp.width);
+    const auto x1 = std::clamp<std::int64_t>(std::max(point0_x, point1_x), 0, btmp.width);
+    const auto y0 = std::clamp<std::int64_t>(std::min(point0_y, point1_y), 0, btmp.height);
+    const auto y1 = std::clamp<std::int64_t>(std::max(point0_y, point1_y), 0, btmp.height);
+    if (!btmp || x0 >= x1) {
+        return;
+    }
+    for (auto y = y0; y < y1; ++y) {
+        std::fill_n(btmp.matrix + y * btmp.width + x0, x1 - x0, argb);
+    }
+}
+
 void draw_square(
     bitmap &btmp, std::size_t center_x, std::size_t center_y, std::size_t radius, Color argb)
 {
@@ -102,14 +277,10 @@ void draw_square(
 void fill_square(
     bitmap &btmp, std::size_t center_x, std::size_t center_y, std::size_t radius, Color argb)
 {
-    const auto begin_x = center_x - radius;
-    const auto begin_y = center_y - radius;
-    const std::size_t len = radius * 2;
-    for (std::size_t i = 0; i < len; i++) {
-        for (std::size_t j = 0; j < len; j++) {
-            pixel(btmp, begin_x + j, begin_y + i) = argb;
-        }
-    }
+    const auto begin_x = std::int64_t(center_x) - std::int64_t(radius);
+    const auto begin_y = std::int64_t(center_y) - std::int64_t(radius);
+    const auto len = std::int64_t(radius * 2);
+    fill_rect(btmp, begin_x, begin_y, begin_x + len, begin_y + len, argb);
 }
 
 void draw_rect(bitmap &btmp,
@@ -157,53 +328,267 @@ void fill_area(bitmap &btmp,
                std::size_t point1_y,
                Color argb)
 {
-    std::int64_t dx = point1_x - point0_x, dy = point1_y - point0_y;
-    if (dx >= 0) {
-        if (dy >= 0) {
-            for (std::int64_t  i = 0; i < dy; i++) {
-                for (std::int64_t  j = 0; j < dx; j++) {
-                    pixel(btmp, point0_x + j, point0_y + i) = argb;
-                }
-            }
-        } else {
-            for (std::int64_t  i = 0; i >= dy; i--) {
-                for (std::int64_t  j = 0; j < dx; j++) {
-                    pixel(btmp, point0_x + j, point0_y + i) = argb;
-                }
+    fill_rect(btmp,
+              std::int64_t(point0_x),
+              std::int64_t(point0_y),
+              std::int64_t(point1_x),
+              std::int64_t(point1_y),
+              argb);
+}
+
+void draw_circle(bitmap &btmp,
+                 std::int64_t center_x,
+                 std::int64_t center_y,
+                 std::int64_t radius,
+                 Color argb)
+{
+    if (!btmp || radius < 0) {
+        return;
+    }
+    const auto w = std::uint64_t(btmp.width);
+    const auto h = std::uint64_t(btmp.height);
+    const auto octants = [&](auto &&plot) {
+        std::int64_t x = radius;
+        std::int64_t y = 0;
+        std::int64_t err = 1 - radius;
+        while (x >= y) {
+            plot(center_x + x, center_y + y);
+            plot(center_x - x, center_y + y);
+            plot(center_x + x, center_y - y);
+            plot(center_x - x, center_y - y);
+            plot(center_x + y, center_y + x);
+            plot(center_x - y, center_y + x);
+            plot(center_x + y, center_y - x);
+            plot(center_x - y, center_y - x);
+            ++y;
+            if (err < 0) {
+                err += 2 * y + 1;
+            } else {
+                --x;
+                err += 2 * (y - x) + 1;
             }
         }
+    };
+
+    /// pixels are bounds checked only if the circle crosses border of the bitmap
+    if (center_x - radius >= 0 && center_y - radius >= 0 && center_x + radius < std::int64_t(w)
+        && center_y + radius < std::int64_t(h)) {
+        octants([&](std::int64_t x, std::int64_t y) { btmp.matrix[y * w + x] = argb; });
     } else {
-        if (dy >= 0) {
-            for (std::int64_t  i = 0; i < dy; i++) {
-                for (std::int64_t  j = 0; j >= dx; j--) {
-                    pixel(btmp, point0_x + j, point0_y + i) = argb;
-                }
+        octants([&](std::int64_t x, std::int64_t y) {
+            if (std::uint64_t(x) < w && std::uint64_t(y) < h) {
+                btmp.matrix[y * w + x] = argb;
             }
+        });
+    }
+}
+
+void fill_circle(bitmap &btmp,
+                 std::int64_t center_x,
+                 std::int64_t center_y,
+                 std::int64_t radius,
+                 Color argb)
+{
+    if (!btmp || radius < 0) {
+        return;
+    }
+    std::int64_t x = radius;
+    std::int64_t y = 0;
+    std::int64_t err = 1 - radius;
+    while (x >= y) {
+        fill_span(btmp, center_x - x, center_x + x, center_y + y, argb);
+        if (y != 0) {
+            fill_span(btmp, center_x - x, center_x + x, center_y - y, argb);
+        }
+        ++y;
+        if (err < 0) {
+            err += 2 * y + 1;
         } else {
-            for (std::int64_t  i = 0; i >= dy; i--) {
-                for (std::int64_t  j = 0; j >= dx; j--) {
-                    pixel(btmp, point0_x + j, point0_y + i) = argb;
-                }
+            /// rows center_y +- x are final now, their half width is y - 1
+            if (x >= y) {
+                fill_span(btmp, center_x - y + 1, center_x + y - 1, center_y + x, argb);
+                fill_span(btmp, center_x - y + 1, center_x + y - 1, center_y - x, argb);
             }
+            --x;
+            err += 2 * (y - x) + 1;
         }
     }
 }
 
-void draw_circle(
-    bitmap &btmp, std::size_t center_x, std::size_t center_y, std::size_t radius, Color argb)
+namespace {
+
+/// Calls f(x, y) for points of one quadrant of ellipse. Decision variables are scaled by 4 to stay integer
+template<typename F>
+void ellipse_quadrant(std::int64_t rx, std::int64_t ry, F &&f)
+{
+    const auto rx2 = rx * rx;
+    const auto ry2 = ry * ry;
+    std::int64_t x = 0;
+    std::int64_t y = ry;
+    std::int64_t px = 0;
+    std::int64_t py = 2 * rx2 * y;
+
+    std::int64_t p = 4 * ry2 - 4 * rx2 * ry + rx2;
+    while (px < py) {
+        f(x, y);
+        ++x;
+        px += 2 * ry2;
+        if (p < 0) {
+            p += 4 * (ry2 + px);
+        } else {
+            --y;
+            py -= 2 * rx2;
+            p += 4 * (ry2 + px - py);
+        }
+    }
+
+    p = ry2 * (2 * x + 1) * (2 * x + 1) + 4 * rx2 * (y - 1) * (y - 1) - 4 * rx2 * ry2;
+    while (y >= 0) {
+        f(x, y);
+        --y;
+        py -= 2 * rx2;
+        if (p > 0) {
+            p += 4 * (rx2 - py);
+        } else {
+            ++x;
+            px += 2 * ry2;
+            p += 4 * (rx2 - py + px);
+        }
+    }
+}
+
+} // namespace
+
+void draw_ellipse(bitmap &btmp,
+                  std::int64_t center_x,
+                  std::int64_t center_y,
+                  std::int64_t radius_x,
+                  std::int64_t radius_y,
+                  Color argb)
+{
+    if (!btmp || radius_x < 0 || radius_y < 0) {
+        return;
+    }
+    if (radius_x == 0 || radius_y == 0) {
+        /// degenerate ellipse is a line, which quadrant stepping misses
+        draw_line_clipped(btmp,
+                          center_x - radius_x,
+                          center_y - radius_y,
+                          center_x + radius_x,
+                          center_y + radius_y,
+                          argb);
+        return;
+    }
+    const auto w = std::uint64_t(btmp.width);
+    const auto h = std::uint64_t(btmp.height);
+    const auto plot = [&](std::int64_t x, std::int64_t y) {
+        if (std::uint64_t(x) < w && std::uint64_t(y) < h) {
+            btmp.matrix[y * w + x] = argb;
+        }
+    };
+    ellipse_quadrant(radius_x, radius_y, [&](std::int64_t x, std::int64_t y) {
+        plot(center_x + x, center_y + y);
+        plot(center_x - x, center_y + y);
+        plot(center_x + x, center_y - y);
+        plot(center_x - x, center_y - y);
+    });
+}
+
+void fill_ellipse(bitmap &btmp,
+                  std::int64_t center_x,
+                  std::int64_t center_y,
+                  std::int64_t radius_x,
+                  std::int64_t radius_y,
+                  Color argb)
+{
+    if (!btmp || radius_x < 0 || radius_y < 0) {
+        return;
+    }
+    if (radius_x == 0 || radius_y == 0) {
+        draw_line_clipped(btmp,
+                          center_x - radius_x,
+                          center_y - radius_y,
+                          center_x + radius_x,
+                          center_y + radius_y,
+                          argb);
+        return;
+    }
+
+    /// only offsets of rows overlapping the bitmap are kept. Rows below and above the center
+    /// give two ranges of offsets, which intersect if both are not empty
+    const auto h = std::int64_t(btmp.height);
+    std::int64_t first = radius_y + 1;
+    std::int64_t last = -1;
+    for (const auto &[from, to] : {std::pair(-center_y, h - 1 - center_y),
+                                   std::pair(center_y - h + 1, center_y)}) {
+        if (std::max<std::int64_t>(from, 0) <= std::min(to, radius_y)) {
+            first = std::min(first, std::max<std::int64_t>(from, 0));
+            last = std::max(last, std::min(to, radius_y));
+        }
+    }
+    if (first > last) {
+        return;
+    }
+
+    /// quadrant visits a row several times, only the widest span of each row is filled
+    std::vector<std::int64_t> half_widths(last - first + 1, -1);
+    ellipse_quadrant(radius_x, radius_y, [&](std::int64_t x, std::int64_t y) {
+        if (y >= first && y <= last) {
+            half_widths[y - first] = std::max(half_widths[y - first], x);
+        }
+    });
+    for (std::int64_t y = first; y <= last; ++y) {
+        const auto hw = half_widths[y - first];
+        fill_span(btmp, center_x - hw, center_x + hw, center_y + y, argb);
+        if (y != 0) {
+            fill_span(btmp, center_x - hw, center_x + hw, center_y - y, argb);
+        }
+    }
+}
+
+void fill_triangle(bitmap &btmp, point p0, point p1, point p2, Color argb)
+{
+    const point points[] = {p0, p1, p2};
+    fill_convex_polygon(btmp, points, 3, argb);
+}
+
+void fill_convex_polygon(bitmap &btmp, const point *points, std::size_t count, Color argb)
 {
-    std::int64_t i2 = std::numeric_limits<std::int64_t>::max();
-    for(std::int64_t i = 0; i + 1 < i2; i++) {
-        i2 = static_cast<std::int64_t>(std::sqrt(radius * radius - i * i));
-        pixel(btmp, center_x + i, center_y + i2) = argb;
-        pixel(btmp, center_x - i, center_y - i2) = argb;
-        pixel(btmp, center_x + i, center_y - i2) = argb;
-        pixel(btmp, center_x - i, center_y + i2) = argb;
+    if (!btmp || count == 0) {
+        return;
+    }
+    const auto [min_it, max_it] = std::minmax_element(points, points + count, [](point a, point b) {
+        return a.y < b.y;
+    });
+    const auto y0 = std::max<std::int64_t>(min_it->y, 0);
+    const auto y1 = std::min<std::int64_t>(max_it->y, std::int64_t(btmp.height) - 1);
+    if (y0 > y1) {
+        return;
+    }
 
-        pixel(btmp, center_x + i2, center_y + i) = argb;
-        pixel(btmp, center_x - i2, center_y - i) = argb;
-        pixel(btmp, center_x - i2, center_y + i) = argb;
-        pixel(btmp, center_x + i2, center_y - i) = argb;
+    /// convex polygon crosses every row once, so each row is a single span between extreme edge intersections
+    const std::size_t rows = y1 - y0 + 1;
+    std::vector<std::int64_t> left(rows, std::numeric_limits<std::int64_t>::max());
+    std::vector<std::int64_t> right(rows, std::numeric_limits<std::int64_t>::min());
+    for (std::size_t i = 0; i < count; ++i) {
+        auto a = points[i];
+        auto b = points[(i + 1) % count];
+        if (a.y > b.y) {
+            std::swap(a, b);
+        }
+        const auto ey0 = std::max(a.y, y0);
+        const auto ey1 = std::min(b.y, y1);
+        for (auto y = ey0; y <= ey1; ++y) {
+            const auto x = a.y == b.y ? a.x : a.x + (y - a.y) * (b.x - a.x) / (b.y - a.y);
+            const auto x_end = a.y == b.y ? b.x : x;
+            left[y - y0] = std::min({left[y - y0], x, x_end});
+            right[y - y0] = std::max({right[y - y0], x, x_end});
+        }
+    }
+    for (std::size_t r = 0; r < rows; ++r) {
+        if (left[r] <= right[r]) {
+            fill_span(btmp, left[r], right[r], y0 + r, argb);
+        }
     }
 }
 
@@ -229,28 +614,78 @@ void draw_grid(bitmap &btmp,
 
 void copy_flipped(bitmap &dst_btmp, const bitmap &src_btmp, bool x_flip, bool y_flip)
 {
-    if(x_flip && y_flip) {
-        for (std::size_t y = 0; y < src_btmp.height; ++y) {
-            for (std::size_t x = 0; x < src_btmp.width; ++x) {
-                pixel(dst_btmp, src_btmp.width - x, src_btmp.height - y) = pixel(src_btmp, x, y);
-            }
-        }
-    } else if(x_flip) {
-        for (std::size_t y = 0; y < src_btmp.height; ++y) {
-            for (std::size_t x = 0; x < src_btmp.width; ++x) {
-                pixel(dst_btmp, src_btmp.width - x, y) = pixel(src_btmp, x, y);
-            }
+    if (!dst_btmp || !src_btmp) {
+        return;
+    }
+    /// flips are relative to copied region which is clipped by both bitmaps
+    const auto w = std::min(dst_btmp.width, src_btmp.width);
+    const auto h = std::min(dst_btmp.height, src_btmp.height);
+    for (std::size_t y = 0; y < h; ++y) {
+        const auto src = src_btmp.matrix + y * src_btmp.width;
+        const auto dst = dst_btmp.matrix + (y_flip ? h - 1 - y : y) * dst_btmp.width;
+        if (x_flip) {
+            std::reverse_copy(src, src + w, dst);
+        } else {
+            std::copy_n(src, w, dst);
         }
-    } else if(y_flip) {
-        for (std::size_t y = 0; y < src_btmp.height; ++y) {
-            for (std::size_t x = 0; x < src_btmp.width; ++x) {
-                pixel(dst_btmp, x, src_btmp.height - y) = pixel(src_btmp, x, y);
-            }
+    }
+}
+
+void rotate_quarter(bitmap &dst_btmp,
+                    const bitmap &src_btmp,
+                    std::size_t quarter_turns,
+                    bool x_flip)
+{
+    quarter_turns %= 4;
+    if (quarter_turns == 0) {
+        copy_flipped(dst_btmp, src_btmp, x_flip, false);
+        return;
+    }
+
+    const std::int64_t w = src_btmp.width;
+    const std::int64_t h = src_btmp.height;
+    const std::size_t dst_w = quarter_turns == 2 ? w : h;
+    const std::size_t dst_h = quarter_turns == 2 ? h : w;
+    if (!src_btmp || dst_btmp.width != dst_w || dst_btmp.height != dst_h) {
+        return;
+    }
+
+    /// source index of destination pixel is linear in its coordinates
+    const auto src_index = [&](std::int64_t x, std::int64_t y) {
+        std::int64_t sx, sy;
+        switch (quarter_turns) {
+        case 1:
+            sx = y;
+            sy = h - 1 - x;
+            break;
+        case 2:
+            sx = w - 1 - x;
+            sy = h - 1 - y;
+            break;
+        default:
+            sx = w - 1 - y;
+            sy = x;
+            break;
         }
-    } else {
-        for (std::size_t y = 0; y < src_btmp.height; ++y) {
-            for (std::size_t x = 0; x < src_btmp.width; ++x) {
-                pixel(dst_btmp, x, y) = pixel(src_btmp, x, y);
+        return sy * w + (x_flip ? w - 1 - sx : sx);
+    };
+    const auto origin = src_index(0, 0);
+    const auto step_x = src_index(1, 0) - origin;
+    const auto step_y = src_index(0, 1) - origin;
+
+    /// tiles keep strided source reads within cache
+    constexpr std::size_t tile = 32;
+    for (std::size_t ty = 0; ty < dst_h; ty += tile) {
+        const auto ty_end = std::min(ty + tile, dst_h);
+        for (std::size_t tx = 0; tx < dst_w; tx += tile) {
+            const auto tx_end = std::min(tx + tile, dst_w);
+            for (auto y = ty; y < ty_end; ++y) {
+                const auto dst = dst_btmp.matrix + y * dst_w;
+                auto src = src_btmp.matrix + origin + std::int64_t(y) * step_y
+                           + std::int64_t(tx) * step_x;
+                for (auto x = tx; x < tx_end; ++x, src += step_x) {
+                    dst[x] = *src;
+                }
             }
         }
     }
@@ -271,6 +706,304 @@ void blit(bitmap &dst_btmp,
     }
 }
 
+void downsample(bitmap &dst_btmp, const bitmap &src_btmp)
+{
+    if (!dst_btmp || !src_btmp) {
+        return;
+    }
+    for (std::size_t y = 0; y < dst_btmp.height; ++y) {
+        const auto y0 = std::min(y * 2, src_btmp.height - 1);
+        const auto y1 = std::min(y * 2 + 1, src_btmp.height - 1);
+        const auto row0 = src_btmp.matrix + y0 * src_btmp.width;
+        const auto row1 = src_btmp.matrix + y1 * src_btmp.width;
+        const auto dst = dst_btmp.matrix + y * dst_btmp.width;
+        for (std::size_t x = 0; x < dst_btmp.width; ++x) {
+            const auto x0 = std::min(x * 2, src_btmp.width - 1);
+            const auto x1 = std::min(x * 2 + 1, src_btmp.width - 1);
+            const std::uint32_t p[] = {row0[x0], row0[x1], row1[x0], row1[x1]};
+            std::uint32_t result = 0;
+            for (std::uint32_t shift = 0; shift < 32; shift += 8) {
+                std::uint32_t sum = 2;
+                for (const auto v : p) {
+                    sum += (v >> shift) & 0xff;
+                }
+                result |= (sum / 4) << shift;
+            }
+            dst[x] = result;
+        }
+    }
+}
+
+void blur(bitmap &btmp,
+          std::int64_t point0_x,
+          std::int64_t point0_y,
+          std::int64_t point1_x,
+          std::int64_t point1_y,
+          std::size_t radius,
+          std::size_t passes)
+{
+    const auto x0 = std::clamp<std::int64_t>(std::min(point0_x, point1_x), 0, btmp.width);
+    const auto x1 = std::clamp<std::int64_t>(std::max(point0_x, point1_x), 0, btmp.width);
+    const auto y0 = std::clamp<std::int64_t>(std::min(point0_y, point1_y), 0, btmp.height);
+    const auto y1 = std::clamp<std::int64_t>(std::max(point0_y, point1_y), 0, btmp.height);
+    const std::size_t w = x1 - x0;
+    const std::size_t h = y1 - y0;
+    if (!btmp || w == 0 || h == 0 || radius == 0 || passes == 0) {
+        return;
+    }
+    radius = std::min(radius, std::max(w, h));
+
+    constexpr std::size_t channels = 4;
+    std::vector<std::uint32_t> planes(w * h * channels);
+    std::vector<std::uint32_t> tmp(w * h);
+    std::vector<std::uint32_t> acc(w);
+    std::vector<std::uint32_t> padded(w + 2 * radius + 1);
+
+    for (std::size_t y = 0; y < h; ++y) {
+        const auto row = btmp.matrix + (y + y0) * btmp.width + x0;
+        for (std::size_t c = 0; c < channels; ++c) {
+            const auto plane = planes.data() + c * w * h + y * w;
+            const auto shift = c * 8;
+            for (std::size_t x = 0; x < w; ++x) {
+                plane[x] = (row[x] >> shift) & 0xff;
+            }
+        }
+    }
+
+    for (std::size_t c = 0; c < channels; ++c) {
+        const auto plane = planes.data() + c * w * h;
+        for (std::size_t p = 0; p < passes; ++p) {
+            for (std::size_t y = 0; y < h; ++y) {
+                blur_line(plane + y * w, tmp.data() + y * w, padded.data(), w, radius);
+            }
+            blur_columns(tmp.data(), plane, acc.data(), w, h, radius);
+        }
+    }
+
+    for (std::size_t y = 0; y < h; ++y) {
+        const auto row = btmp.matrix + (y + y0) * btmp.width + x0;
+        std::fill(row, row + w, 0);
+        for (std::size_t c = 0; c < channels; ++c) {
+            const auto plane = planes.data() + c * w * h + y * w;
+            const auto shift = c * 8;
+            for (std::size_t x = 0; x < w; ++x) {
+                row[x] |= plane[x] << shift;
+            }
+        }
+    }
+}
+
+lens_map make_lens_map(std::size_t radius, double coefficient)
+{
+    lens_map result{.radius = radius, .coefficient = coefficient, .reach = radius, .entries = {}};
+    coefficient = std::clamp(coefficient, -0.99, 0.99);
+    const auto r = std::int64_t(radius);
+    const auto r2 = double(r * r);
+    for (std::int64_t dy = -r; dy <= r; ++dy) {
+        for (std::int64_t dx = -r; dx <= r; ++dx) {
+            const auto d2 = (dx * dx + dy * dy) / r2;
+            if (d2 >= 1) {
+                continue;
+            }
+            const auto factor = 1 - coefficient * (1 - d2);
+            const auto src_dx = std::int32_t(std::lround(dx * factor));
+            const auto src_dy = std::int32_t(std::lround(dy * factor));
+            if (src_dx != dx || src_dy != dy) {
+                result.entries.push_back(lens_map::entry{.dx = std::int32_t(dx),
+                                                         .dy = std::int32_t(dy),
+                                                         .src_dx = src_dx,
+                                                         .src_dy = src_dy});
+                result.reach = std::max<std::size_t>(
+                    result.reach, std::max(std::abs(src_dx), std::abs(src_dy)));
+            }
+        }
+    }
+    return result;
+}
+
+void apply_lens(bitmap &btmp, const lens_map &map, std::int64_t center_x, std::int64_t center_y)
+{
+    if (!btmp || map.entries.empty()) {
+        return;
+    }
+    const auto reach = std::int64_t(map.reach);
+    const auto y0 = std::clamp<std::int64_t>(center_y - reach, 0, btmp.height);
+    const auto y1 = std::clamp<std::int64_t>(center_y + reach + 1, 0, btmp.height);
+    if (y0 >= y1 || center_x + reach < 0 || center_x - reach >= std::int64_t(btmp.width)) {
+        return;
+    }
+
+    /// sources must be read before they are overwritten, so rows under the lens are saved first
+    std::vector<std::uint32_t> src(btmp.matrix + y0 * btmp.width, btmp.matrix + y1 * btmp.width);
+    const auto w = std::int64_t(btmp.width);
+    for (const auto &e : map.entries) {
+        const auto x = center_x + e.dx;
+        const auto y = center_y + e.dy;
+        const auto sx = center_x + e.src_dx;
+        const auto sy = center_y + e.src_dy;
+        if (x < 0 || x >= w || y < y0 || y >= y1 || sx < 0 || sx >= w || sy < y0 || sy >= y1) {
+            continue;
+        }
+        btmp.matrix[y * w + x] = src[(sy - y0) * w + sx];
+    }
+}
+
+namespace {
+
+inline void blend_pixel(std::uint32_t &bottom, std::uint32_t top)
+{
+    const auto alpha = top >> 24;
+    if (alpha == 0xff) {
+        bottom = top;
+    } else if (alpha != 0) {
+        bottom = e172::blend(top, bottom);
+    }
+}
+
+} // namespace
+
+namespace {
+
+/// Calls f(dst_row, src_row, len) for every row of intersection of dst and w x h part of src
+/// starting at (src_x, src_y) placed at (offset_x, offset_y)
+template<typename F>
+void for_each_translated_row(bitmap &dst_btmp,
+                             const bitmap &src_btmp,
+                             std::size_t src_x,
+                             std::size_t src_y,
+                             std::size_t w,
+                             std::size_t h,
+                             std::int64_t offset_x,
+                             std::int64_t offset_y,
+                             const F &f)
+{
+    if (!dst_btmp || !src_btmp || src_x >= src_btmp.width || src_y >= src_btmp.height) {
+        return;
+    }
+    const auto src_w = std::int64_t(std::min(w, src_btmp.width - src_x));
+    const auto src_h = std::int64_t(std::min(h, src_btmp.height - src_y));
+    const auto x0 = std::max<std::int64_t>(offset_x, 0);
+    const auto y0 = std::max<std::int64_t>(offset_y, 0);
+    const auto x1 = std::min<std::int64_t>(offset_x + src_w, dst_btmp.width);
+    const auto y1 = std::min<std::int64_t>(offset_y + src_h, dst_btmp.height);
+    if (x0 >= x1 || y0 >= y1) {
+        return;
+    }
+    const std::size_t len = x1 - x0;
+    const auto origin = src_btmp.matrix + src_y * src_btmp.width + src_x;
+    for (auto y = y0; y < y1; ++y) {
+        f(dst_btmp.matrix + y * dst_btmp.width + x0,
+          origin + (y - offset_y) * src_btmp.width + (x0 - offset_x),
+          len);
+    }
+}
+
+void blend_row(std::uint32_t *dst, const std::uint32_t *src, std::size_t len)
+{
+    for (std::size_t i = 0; i < len; ++i) {
+        blend_pixel(dst[i], src[i]);
+    }
+}
+
+void copy_row(std::uint32_t *dst, const std::uint32_t *src, std::size_t len)
+{
+    std::copy_n(src, len, dst);
+}
+
+} // namespace
+
+void blit_translated(bitmap &dst_btmp,
+                     const bitmap &src_btmp,
+                     std::int64_t offset_x,
+                     std::int64_t offset_y,
+                     std::size_t w,
+                     std::size_t h)
+{
+    for_each_translated_row(dst_btmp, src_btmp, 0, 0, w, h, offset_x, offset_y, blend_row);
+}
+
+void copy_translated(bitmap &dst_btmp,
+                     const bitmap &src_btmp,
+                     std::int64_t offset_x,
+                     std::int64_t offset_y,
+                     std::size_t w,
+                     std::size_t h)
+{
+    for_each_translated_row(dst_btmp, src_btmp, 0, 0, w, h, offset_x, offset_y, copy_row);
+}
+
+void blit_region(bitmap &dst_btmp,
+                 const bitmap &src_btmp,
+                 std::size_t src_x,
+                 std::size_t src_y,
+                 std::size_t w,
+                 std::size_t h,
+                 std::int64_t offset_x,
+                 std::int64_t offset_y)
+{
+    for_each_translated_row(dst_btmp, src_btmp, src_x, src_y, w, h, offset_x, offset_y, blend_row);
+}
+
+void copy_region(bitmap &dst_btmp,
+                 const bitmap &src_btmp,
+                 std::size_t src_x,
+                 std::size_t src_y,
+                 std::size_t w,
+                 std::size_t h,
+                 std::int64_t offset_x,
+                 std::int64_t offset_y)
+{
+    for_each_translated_row(dst_btmp, src_btmp, src_x, src_y, w, h, offset_x, offset_y, copy_row);
+}
+
+void blit_scaled(bitmap &dst_btmp,
+                 const bitmap &src_btmp,
+                 double scaler,
+                 std::int64_t center_x,
+                 std::int64_t center_y)
+{
+    if (!dst_btmp || !src_btmp || !(scaler > 0)) {
+        return;
+    }
+
+    /// source index of every destination column (or row) which hits the source
+    const auto make_table = [scaler](std::size_t src_len,
+                                     std::size_t dst_len,
+                                     std::int64_t center,
+                                     std::int64_t &first) {
+        std::vector<std::uint32_t> table;
+        const auto half = double(src_len) / 2 * scaler;
+        const auto begin = std::max<std::int64_t>(std::int64_t(-half), -center);
+        const auto end = std::min<double>(half, double(dst_len) - center);
+        first = begin + center;
+        for (auto i = begin; i < end; ++i) {
+            const auto s = i / scaler + double(src_len / 2);
+            if (s < 0) {
+                ++first;
+                continue;
+            }
+            if (s >= src_len) {
+                break;
+            }
+            table.push_back(std::uint32_t(s));
+        }
+        return table;
+    };
+
+    std::int64_t first_x;
+    std::int64_t first_y;
+    const auto columns = make_table(src_btmp.width, dst_btmp.width, center_x, first_x);
+    const auto rows = make_table(src_btmp.height, dst_btmp.height, center_y, first_y);
+
+    for (std::size_t r = 0; r < rows.size(); ++r) {
+        const auto src = src_btmp.matrix + std::size_t(rows[r]) * src_btmp.width;
+        const auto dst = dst_btmp.matrix + (first_y + r) * dst_btmp.width + first_x;
+        for (std::size_t c = 0; c < columns.size(); ++c) {
+            blend_pixel(dst[c], src[columns[c]]);
+        }
+    }
+}
+
 void blit_transformed(bitmap &dst_btmp,
                       const bitmap &src_btmp,
                       const std::complex<double> &rotor,
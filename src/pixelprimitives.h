@@ -1,10 +1,13 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
 #include <complex>
 #include <cstdint>
 #include <e172/graphics/color.h>
+#include <limits>
 #include <type_traits>
+#include <vector>
 
 namespace e172::impl::console::pixel_primitives {
 
@@ -62,6 +65,43 @@ void draw_line(bitmap &btmp,
                std::int64_t point1_y,
                e172::Color argb);
 
+/// Clips line to bitmap bounds. Returns false if nothing of line is inside
+bool clip_line(const bitmap &btmp,
+               std::int64_t &point0_x,
+               std::int64_t &point0_y,
+               std::int64_t &point1_x,
+               std::int64_t &point1_y);
+
+/// Line which is clipped once instead of checking bounds of every pixel
+void draw_line_clipped(bitmap &btmp,
+                       std::int64_t point0_x,
+                       std::int64_t point0_y,
+                       std::int64_t point1_x,
+                       std::int64_t point1_y,
+                       e172::Color argb);
+
+/// Fills [point0_x, point1_x] of row y clipped to bitmap bounds
+inline void fill_span(
+    bitmap &btmp, std::int64_t point0_x, std::int64_t point1_x, std::int64_t y, e172::Color argb)
+{
+    if (y < 0 || y >= std::int64_t(btmp.height) || !btmp) {
+        return;
+    }
+    const auto x0 = std::max<std::int64_t>(point0_x, 0);
+    const auto x1 = std::min<std::int64_t>(point1_x, std::int64_t(btmp.width) - 1);
+    if (x0 <= x1) {
+        std::fill_n(btmp.matrix + y * btmp.width + x0, x1 - x0 + 1, argb);
+    }
+}
+
+/// Fills [min_x, max_x) x [min_y, max_y) clipped to bitmap bounds with row stores
+void fill_rect(bitmap &btmp,
+               std::int64_t point0_x,
+               std::int64_t point0_y,
+               std::int64_t point1_x,
+               std::int64_t point1_y,
+               e172::Color argb);
+
 inline void draw_vertical_line(
     bitmap &btmp, std::size_t point_x, std::size_t point_y, std::size_t len, e172::Color argb)
 {
@@ -96,8 +136,43 @@ void fill_area(bitmap &btmp,
                std::size_t point1_y,
                e172::Color argb);
 
-void draw_circle(
-    bitmap &btmp, std::size_t center_x, std::size_t center_y, std::size_t radius, e172::Color argb);
+/// Integer midpoint circle
+void draw_circle(bitmap &btmp,
+                 std::int64_t center_x,
+                 std::int64_t center_y,
+                 std::int64_t radius,
+                 e172::Color argb);
+
+void fill_circle(bitmap &btmp,
+                 std::int64_t center_x,
+                 std::int64_t center_y,
+                 std::int64_t radius,
+                 e172::Color argb);
+
+/// Integer midpoint ellipse. Radii must not exceed 2^15, decision variables overflow otherwise
+void draw_ellipse(bitmap &btmp,
+                  std::int64_t center_x,
+                  std::int64_t center_y,
+                  std::int64_t radius_x,
+                  std::int64_t radius_y,
+                  e172::Color argb);
+
+void fill_ellipse(bitmap &btmp,
+                  std::int64_t center_x,
+                  std::int64_t center_y,
+                  std::int64_t radius_x,
+                  std::int64_t radius_y,
+                  e172::Color argb);
+
+struct point {
+    std::int64_t x = 0;
+    std::int64_t y = 0;
+};
+
+void fill_triangle(bitmap &btmp, point p0, point p1, point p2, e172::Color argb);
+
+/// Points must form convex polygon (in any winding order)
+void fill_convex_polygon(bitmap &btmp, const point *points, std::size_t count, e172::Color argb);
 
 void draw_grid(bitmap &btmp,
                std::int64_t point0_x,
@@ -109,6 +184,13 @@ void draw_grid(bitmap &btmp,
 
 void copy_flipped(bitmap &dst_btmp, const bitmap &src_btmp, bool x_flip, bool y_flip);
 
+/// Copies src (mirrored horizontally first if x_flip) rotated clockwise by quarter_turns * 90
+/// degrees. dst must have src sizes swapped for odd number of turns
+void rotate_quarter(bitmap &dst_btmp,
+                    const bitmap &src_btmp,
+                    std::size_t quarter_turns,
+                    bool x_flip = false);
+
 inline void copy(bitmap &dst_btmp, const bitmap &src_btmp) {
     copy_flipped(dst_btmp, src_btmp, false, false);
 }
@@ -130,6 +212,52 @@ inline void blit(bitmap &dst_btmp, const bitmap &src_btmp, std::size_t offset_x,
     blit(dst_btmp, src_btmp, offset_x, offset_y, src_btmp.width, src_btmp.height);
 }
 
+/// Blends top left w x h part of src (whole src by default) with its top left corner at
+/// (offset_x, offset_y). Clipped once, opaque pixels are copied
+void blit_translated(bitmap &dst_btmp,
+                     const bitmap &src_btmp,
+                     std::int64_t offset_x,
+                     std::int64_t offset_y,
+                     std::size_t w = std::numeric_limits<std::size_t>::max(),
+                     std::size_t h = std::numeric_limits<std::size_t>::max());
+
+/// Same as blit_translated but overwrites destination pixels (row memcpy)
+void copy_translated(bitmap &dst_btmp,
+                     const bitmap &src_btmp,
+                     std::int64_t offset_x,
+                     std::int64_t offset_y,
+                     std::size_t w = std::numeric_limits<std::size_t>::max(),
+                     std::size_t h = std::numeric_limits<std::size_t>::max());
+
+/// Blends w x h part of src starting at (src_x, src_y) with its top left corner at
+/// (offset_x, offset_y). Used to draw sub-images straight from an atlas
+void blit_region(bitmap &dst_btmp,
+                 const bitmap &src_btmp,
+                 std::size_t src_x,
+                 std::size_t src_y,
+                 std::size_t w,
+                 std::size_t h,
+                 std::int64_t offset_x,
+                 std::int64_t offset_y);
+
+/// Same as blit_region but overwrites destination pixels
+void copy_region(bitmap &dst_btmp,
+                 const bitmap &src_btmp,
+                 std::size_t src_x,
+                 std::size_t src_y,
+                 std::size_t w,
+                 std::size_t h,
+                 std::int64_t offset_x,
+                 std::int64_t offset_y);
+
+/// Axis aligned scale of src with center at (center_x, center_y). Covers the same pixels as
+/// blit_transformed with identity rotor, but samples through precomputed row and column tables
+void blit_scaled(bitmap &dst_btmp,
+                 const bitmap &src_btmp,
+                 double scaler,
+                 std::int64_t center_x,
+                 std::int64_t center_y);
+
 void blit_transformed(bitmap &dst_btmp,
                       const bitmap &src_btmp,
                       const std::complex<double> &rotor,
@@ -158,4 +286,40 @@ inline void blit_rotated(
         const std::complex<double> &rotor
         ) { blit_rotated(dst_btmp, src_btmp, rotor, src_btmp.width / 2, src_btmp.height / 2); }
 
+/// 2x2 box filter of src into dst of half its size (used to build mip levels)
+void downsample(bitmap &dst_btmp, const bitmap &src_btmp);
+
+/// Separable box blur of area between two points. Rows and columns are blurred with running sums,
+/// so cost per pixel does not depend on radius. Several passes approximate gaussian blur.
+void blur(bitmap &btmp,
+          std::int64_t point0_x,
+          std::int64_t point0_y,
+          std::int64_t point1_x,
+          std::int64_t point1_y,
+          std::size_t radius,
+          std::size_t passes = 1);
+
+/// Precomputed displacement map of a lens. Does not depend on lens center,
+/// so the same map can be applied anywhere on the bitmap.
+struct lens_map {
+    struct entry {
+        std::int32_t dx;
+        std::int32_t dy;
+        std::int32_t src_dx;
+        std::int32_t src_dy;
+    };
+
+    std::size_t radius = 0;
+    double coefficient = 0;
+    /// max distance between displaced pixel and the center
+    std::size_t reach = 0;
+    /// only pixels which are actually displaced
+    std::vector<entry> entries;
+};
+
+/// coefficient > 0 magnifies the center of the lens, coefficient < 0 shrinks it
+lens_map make_lens_map(std::size_t radius, double coefficient);
+
+void apply_lens(bitmap &btmp, const lens_map &map, std::int64_t center_x, std::int64_t center_y);
+
 }; // namespace e172::impl::console::pixel_primitives
@@ -1,82 +1,159 @@
 #include "png_reader.h"
 
+#include <bit>
+#include <cstring>
 #include <png.h>
-#include <bsd/stdio.h>
+#include <vector>
 
 namespace e172::impl::console::png {
 
-pixel_primitives::bitmap read(std::istream &stream)
+namespace {
+
+/// Owns libpng read and info structs
+struct ReadStruct
 {
-    auto fp = fropen(
-                &stream,
-                []/* readfn  */(void *c, char * buf, int siz) -> int {
-                    return reinterpret_cast<std::istream*>(c)
-                    ->readsome(buf, siz);
-                }
-                );
+    png_structp png = nullptr;
+    png_infop info = nullptr;
 
-    std::uint8_t header[8]; // 8 is the maximum size that can be checked
+    ~ReadStruct() { png_destroy_read_struct(&png, info ? &info : nullptr, nullptr); }
+};
 
-    if (!fp)
-        throw PNGDecodingException("stream could not be opened for reading");
+/// State which must survive longjmp out of libpng, so it lives outside of frame calling setjmp
+struct Output
+{
+    const Allocator &allocate;
+    pixel_primitives::bitmap bitmap;
+    bool owned = false;
+    std::vector<png_bytep> rows;
+};
 
-    fread(header, 1, 8, fp);
-    if (png_sig_cmp(header, 0, 8))
-        throw PNGDecodingException("decoding png failed. stream data is not recognized as a PNG");
+void read_data(png_structp png, png_bytep data, png_size_t length)
+{
+    auto &stream = *static_cast<std::istream *>(png_get_io_ptr(png));
+    if (!stream.read(reinterpret_cast<char *>(data), length)) {
+        png_error(png, "unexpected end of stream");
+    }
+}
 
-    /* initialize stuff */
-    const auto png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+/// Sets transforms which make libpng output every pixel as native endian 0xAARRGGBB word
+/// whatever color type and bit depth of source is
+void set_argb_transforms(png_structp png, png_infop info)
+{
+    const auto color_type = png_get_color_type(png, info);
+    const auto bit_depth = png_get_bit_depth(png, info);
 
-    if (!png_ptr)
-        throw PNGDecodingException("decoding png failed. png_create_read_struct failed");
+    if (color_type == PNG_COLOR_TYPE_PALETTE) {
+        png_set_palette_to_rgb(png);
+    }
+    if (color_type == PNG_COLOR_TYPE_GRAY && bit_depth < 8) {
+        png_set_expand_gray_1_2_4_to_8(png);
+    }
+    if (bit_depth == 16) {
+        png_set_strip_16(png);
+    }
+    if (color_type == PNG_COLOR_TYPE_GRAY || color_type == PNG_COLOR_TYPE_GRAY_ALPHA) {
+        png_set_gray_to_rgb(png);
+    }
 
-    const auto info_ptr = png_create_info_struct(png_ptr);
-    if (!info_ptr)
-        throw PNGDecodingException("decoding png failed. png_create_info_struct failed");
+    const bool little_endian = std::endian::native == std::endian::little;
+    if (png_get_valid(png, info, PNG_INFO_tRNS)) {
+        png_set_tRNS_to_alpha(png);
+    } else if (!(color_type & PNG_COLOR_MASK_ALPHA)) {
+        png_set_filler(png, 0xff, little_endian ? PNG_FILLER_AFTER : PNG_FILLER_BEFORE);
+    }
 
-    if (setjmp(png_jmpbuf(png_ptr)))
-        throw PNGDecodingException("decoding png failed. error during init_io");
+    if (little_endian) {
+        /// memory order B G R A
+        png_set_bgr(png);
+    } else {
+        /// memory order A R G B
+        png_set_swap_alpha(png);
+    }
 
-    png_init_io(png_ptr, fp);
-    png_set_sig_bytes(png_ptr, 8);
+    png_set_interlace_handling(png);
+    png_read_update_info(png, info);
+}
 
-    png_read_info(png_ptr, info_ptr);
+/// Returns false if libpng reported an error. Nothing with nontrivial destructor may be
+/// created in this frame since libpng leaves it with longjmp
+bool decode(png_structp png, png_infop info, Output &output)
+{
+    if (setjmp(png_jmpbuf(png))) {
+        return false;
+    }
 
-    const auto width = png_get_image_width(png_ptr, info_ptr);
-    const auto height = png_get_image_height(png_ptr, info_ptr);
-    const auto color_type = png_get_color_type(png_ptr, info_ptr);
-    const auto bit_depth = png_get_bit_depth(png_ptr, info_ptr);
-    const auto number_of_passes = png_set_interlace_handling(png_ptr);
+    png_read_info(png, info);
+    set_argb_transforms(png, info);
 
-    (void) color_type;
-    (void) bit_depth;
-    (void) number_of_passes;
+    const std::size_t width = png_get_image_width(png, info);
+    const std::size_t height = png_get_image_height(png, info);
+    if (png_get_rowbytes(png, info) != width * sizeof(std::uint32_t)) {
+        png_error(png, "unsupported pixel format");
+    }
 
-    png_read_update_info(png_ptr, info_ptr);
+    if (output.allocate) {
+        output.bitmap = {output.allocate(width, height), width, height};
+    } else {
+        output.bitmap = {new std::uint32_t[width * height], width, height};
+        output.owned = true;
+    }
 
-    /* read file */
-    if (setjmp(png_jmpbuf(png_ptr)))
-        throw PNGDecodingException("decoding png failed. error during read_image");
+    /// rows are decoded straight into result
+    output.rows.resize(height);
+    for (std::size_t y = 0; y < height; ++y) {
+        output.rows[y] = reinterpret_cast<png_bytep>(output.bitmap.matrix + y * width);
+    }
+    png_read_image(png, output.rows.data());
+    png_read_end(png, nullptr);
+    return true;
+}
 
-    const auto row_pointers = (png_bytep*) malloc(sizeof(png_bytep) * height);
-    for (std::size_t y = 0; y < height; y++)
-        row_pointers[y] = (png_byte*) malloc(png_get_rowbytes(png_ptr,info_ptr));
+} // namespace
 
-    png_read_image(png_ptr, row_pointers);
+pixel_primitives::bitmap read(std::istream &stream, const Allocator &allocate)
+{
+    png_byte header[8]; // 8 is the maximum size that can be checked
+    if (!stream.read(reinterpret_cast<char *>(header), sizeof(header))
+        || png_sig_cmp(header, 0, sizeof(header))) {
+        throw PNGDecodingException("decoding png failed. stream data is not recognized as a PNG");
+    }
+
+    ReadStruct reader;
+    reader.png = png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+    if (!reader.png) {
+        throw PNGDecodingException("decoding png failed. png_create_read_struct failed");
+    }
+    reader.info = png_create_info_struct(reader.png);
+    if (!reader.info) {
+        throw PNGDecodingException("decoding png failed. png_create_info_struct failed");
+    }
 
-    pixel_primitives::bitmap result = { new uint32_t[width * height], width, height };
+    png_set_read_fn(reader.png, &stream, read_data);
+    png_set_sig_bytes(reader.png, sizeof(header));
 
-    for (std::size_t y = 0; y < height; y++) {
-        png_byte* row = row_pointers[y];
-        for (std::size_t x = 0; x < width; x++) {
-            png_byte* ptr = &(row[x*4]);
-            std::uint32_t argb = (ptr[3] << 24) | (ptr[0] << 16) | (ptr[1] << 8) | (ptr[2] << 0);
-            pixel_primitives::pixel(result, x, y) = argb;
+    Output output{allocate, {}, false, {}};
+    if (!decode(reader.png, reader.info, output)) {
+        if (output.owned) {
+            delete[] output.bitmap.matrix;
         }
-        free(row);
+        throw PNGDecodingException("decoding png failed. error during read_image");
+    }
+    return output.bitmap;
+}
+
+bool readSize(std::istream &stream, std::size_t &width, std::size_t &height)
+{
+    /// signature (8), IHDR length (4), "IHDR" (4), width (4), height (4)
+    std::uint8_t header[24];
+    if (!stream.read(reinterpret_cast<char *>(header), sizeof(header))) {
+        return false;
+    }
+    if (png_sig_cmp(header, 0, 8) || std::memcmp(header + 12, "IHDR", 4) != 0) {
+        return false;
     }
-    free(row_pointers);
-    return result;
+    width = png_get_uint_32(header + 16);
+    height = png_get_uint_32(header + 20);
+    return true;
 }
 
 } // namespace e172::impl::console::png
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <functional>
 #include <istream>
 #include "pixelprimitives.h"
 
@@ -17,6 +18,13 @@ private:
     const char *m_what;
 };
 
-pixel_primitives::bitmap read(std::istream &stream);
+/// Returns buffer for width * height pixels which becomes matrix of decoded bitmap
+using Allocator = std::function<std::uint32_t *(std::size_t width, std::size_t height)>;
+
+/// If `allocate` is empty result matrix is allocated with new[]
+pixel_primitives::bitmap read(std::istream &stream, const Allocator &allocate = {});
+
+/// Reads image size from header without decoding. Returns false if stream is not a PNG
+bool readSize(std::istream &stream, std::size_t &width, std::size_t &height);
 
 } // namespace e172::impl::console::png
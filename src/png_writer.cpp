@@ -0,0 +1,133 @@
+#include "png_writer.h"
+
+#include <bit>
+#include <fstream>
+#include <png.h>
+#include <vector>
+
+namespace e172::impl::console::png {
+
+namespace {
+
+/// Owns libpng write and info structs
+struct WriteStruct
+{
+    png_structp png = nullptr;
+    png_infop info = nullptr;
+
+    ~WriteStruct() { png_destroy_write_struct(&png, info ? &info : nullptr); }
+};
+
+void write_data(png_structp png, png_bytep data, png_size_t length)
+{
+    auto &stream = *static_cast<std::ostream *>(png_get_io_ptr(png));
+    if (!stream.write(reinterpret_cast<const char *>(data), length)) {
+        png_error(png, "stream write failed");
+    }
+}
+
+void flush_data(png_structp png)
+{
+    static_cast<std::ostream *>(png_get_io_ptr(png))->flush();
+}
+
+bool opaque(const pixel_primitives::bitmap &bitmap)
+{
+    const auto count = bitmap.width * bitmap.height;
+    std::uint32_t alpha = 0xff000000;
+    for (std::size_t i = 0; i < count; ++i) {
+        alpha &= bitmap.matrix[i];
+    }
+    return alpha == 0xff000000;
+}
+
+/// Returns false if libpng reported an error. Nothing with nontrivial destructor may be
+/// created in this frame since libpng leaves it with longjmp
+bool encode(png_structp png,
+            png_infop info,
+            const pixel_primitives::bitmap &bitmap,
+            const WriteOptions &options,
+            std::vector<png_bytep> &rows)
+{
+    if (setjmp(png_jmpbuf(png))) {
+        return false;
+    }
+
+    const bool has_alpha = !opaque(bitmap);
+    png_set_IHDR(png,
+                 info,
+                 bitmap.width,
+                 bitmap.height,
+                 8,
+                 has_alpha ? PNG_COLOR_TYPE_RGB_ALPHA : PNG_COLOR_TYPE_RGB,
+                 PNG_INTERLACE_NONE,
+                 PNG_COMPRESSION_TYPE_DEFAULT,
+                 PNG_FILTER_TYPE_DEFAULT);
+    png_set_compression_level(png, options.compressionLevel);
+    if (options.noFilter) {
+        png_set_filter(png, PNG_FILTER_TYPE_BASE, PNG_FILTER_NONE);
+    }
+    png_write_info(png, info);
+
+    /// input words are native endian 0xAARRGGBB
+    const bool little_endian = std::endian::native == std::endian::little;
+    if (little_endian) {
+        png_set_bgr(png);
+    } else {
+        png_set_swap_alpha(png);
+    }
+    if (!has_alpha) {
+        png_set_filler(png, 0, little_endian ? PNG_FILLER_AFTER : PNG_FILLER_BEFORE);
+    }
+
+    png_write_image(png, rows.data());
+    png_write_end(png, nullptr);
+    return true;
+}
+
+} // namespace
+
+void write(std::ostream &stream, const pixel_primitives::bitmap &bitmap, const WriteOptions &options)
+{
+    if (!bitmap || bitmap.width == 0 || bitmap.height == 0) {
+        throw PNGEncodingException("encoding png failed. bitmap is empty");
+    }
+
+    WriteStruct writer;
+    writer.png = png_create_write_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+    if (!writer.png) {
+        throw PNGEncodingException("encoding png failed. png_create_write_struct failed");
+    }
+    writer.info = png_create_info_struct(writer.png);
+    if (!writer.info) {
+        throw PNGEncodingException("encoding png failed. png_create_info_struct failed");
+    }
+    png_set_write_fn(writer.png, &stream, write_data, flush_data);
+
+    std::vector<png_bytep> rows(bitmap.height);
+    for (std::size_t y = 0; y < bitmap.height; ++y) {
+        rows[y] = reinterpret_cast<png_bytep>(bitmap.matrix + y * bitmap.width);
+    }
+    if (!encode(writer.png, writer.info, bitmap, options, rows)) {
+        throw PNGEncodingException("encoding png failed. error during write_image");
+    }
+}
+
+bool save(const std::string &path,
+          const pixel_primitives::bitmap &bitmap,
+          const WriteOptions &options)
+{
+    std::ofstream ofile(path, std::ios::out | std::ios::binary);
+    if (!ofile) {
+        return false;
+    }
+    try {
+        write(ofile, bitmap, options);
+    } catch (const PNGEncodingException &) {
+        return false;
+    }
+    ofile.close();
+    return !ofile.fail();
+}
+
+} // namespace e172::impl::console::png
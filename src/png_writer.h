@@ -0,0 +1,43 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+#include "pixelprimitives.h"
+
+namespace e172::impl::console::png {
+
+class PNGEncodingException : public std::exception
+{
+public:
+    PNGEncodingException(const char *what)
+        : m_what(what)
+    {}
+    const char *what() const noexcept { return m_what; }
+
+private:
+    const char *m_what;
+};
+
+struct WriteOptions
+{
+    /// zlib level, 0 (store) - 9 (best)
+    int compressionLevel = 6;
+    /// Disables row filters. Encodes several times faster at the cost of size
+    bool noFilter = false;
+
+    /// Options for screenshots and frame dumps
+    static WriteOptions fast() { return WriteOptions{1, true}; }
+};
+
+/// Writes 8 bit RGBA PNG (RGB if all pixels are opaque). Rows are passed to libpng
+/// straight from bitmap
+void write(std::ostream &stream,
+           const pixel_primitives::bitmap &bitmap,
+           const WriteOptions &options = {});
+
+/// Writes file at `path`. Returns false if it could not be encoded or written
+bool save(const std::string &path,
+          const pixel_primitives::bitmap &bitmap,
+          const WriteOptions &options = {});
+
+} // namespace e172::impl::console::png
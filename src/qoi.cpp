@@ -0,0 +1,227 @@
+#include "qoi.h"
+
+#include <array>
+#include <cstring>
+#include <iterator>
+#include <vector>
+
+namespace e172::impl::console::qoi {
+
+namespace {
+
+constexpr std::size_t header_size = 14;
+constexpr std::uint8_t end_marker[] = {0, 0, 0, 0, 0, 0, 0, 1};
+
+constexpr std::uint8_t op_index = 0x00;
+constexpr std::uint8_t op_diff = 0x40;
+constexpr std::uint8_t op_luma = 0x80;
+constexpr std::uint8_t op_run = 0xc0;
+constexpr std::uint8_t op_rgb = 0xfe;
+constexpr std::uint8_t op_rgba = 0xff;
+constexpr std::uint8_t mask_2 = 0xc0;
+
+/// Limit from reference implementation which keeps size computations in 32 bits
+constexpr std::size_t max_pixels = 400000000;
+
+std::uint32_t read_u32(const std::uint8_t *bytes)
+{
+    return std::uint32_t(bytes[0]) << 24 | std::uint32_t(bytes[1]) << 16
+           | std::uint32_t(bytes[2]) << 8 | std::uint32_t(bytes[3]);
+}
+
+void write_u32(std::vector<std::uint8_t> &bytes, std::uint32_t value)
+{
+    bytes.push_back(value >> 24);
+    bytes.push_back(value >> 16);
+    bytes.push_back(value >> 8);
+    bytes.push_back(value);
+}
+
+bool read_header(const std::uint8_t *bytes, std::size_t &width, std::size_t &height)
+{
+    if (std::memcmp(bytes, "qoif", 4) != 0) {
+        return false;
+    }
+    width = read_u32(bytes + 4);
+    height = read_u32(bytes + 8);
+    const auto channels = bytes[12];
+    return width > 0 && height > 0 && width * height <= max_pixels
+           && (channels == 3 || channels == 4);
+}
+
+/// Pixels are kept as 0xAARRGGBB words
+std::size_t hash(std::uint32_t argb)
+{
+    const auto a = argb >> 24;
+    const auto r = (argb >> 16) & 0xff;
+    const auto g = (argb >> 8) & 0xff;
+    const auto b = argb & 0xff;
+    return (r * 3 + g * 5 + b * 7 + a * 11) % 64;
+}
+
+std::uint32_t with_rgb(std::uint32_t argb, std::uint32_t r, std::uint32_t g, std::uint32_t b)
+{
+    return (argb & 0xff000000) | (r & 0xff) << 16 | (g & 0xff) << 8 | (b & 0xff);
+}
+
+std::vector<std::uint8_t> read_all(std::istream &stream)
+{
+    const auto begin = stream.tellg();
+    if (begin >= 0 && stream.seekg(0, std::ios::end)) {
+        const auto end = stream.tellg();
+        stream.seekg(begin);
+        std::vector<std::uint8_t> result(end - begin);
+        stream.read(reinterpret_cast<char *>(result.data()), result.size());
+        result.resize(stream.gcount());
+        return result;
+    }
+    /// not seekable
+    stream.clear();
+    return {std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>()};
+}
+
+} // namespace
+
+bool readSize(std::istream &stream, std::size_t &width, std::size_t &height)
+{
+    std::uint8_t header[header_size];
+    return stream.read(reinterpret_cast<char *>(header), header_size)
+           && read_header(header, width, height);
+}
+
+pixel_primitives::bitmap read(std::istream &stream, const Allocator &allocate)
+{
+    const auto bytes = read_all(stream);
+    std::size_t width;
+    std::size_t height;
+    if (bytes.size() < header_size + sizeof(end_marker)
+        || !read_header(bytes.data(), width, height)) {
+        throw QOIDecodingException("decoding qoi failed. stream data is not recognized as a QOI");
+    }
+
+    const auto count = width * height;
+    pixel_primitives::bitmap result = {allocate ? allocate(width, height)
+                                                : new std::uint32_t[count],
+                                       width,
+                                       height};
+
+    std::array<std::uint32_t, 64> index{};
+    std::uint32_t px = 0xff000000;
+    const auto end = bytes.size() - sizeof(end_marker);
+    std::size_t p = header_size;
+    std::size_t i = 0;
+    while (i < count && p < end) {
+        const auto b1 = bytes[p++];
+        if (b1 == op_rgb) {
+            if (p + 3 > end) {
+                break;
+            }
+            px = with_rgb(px, bytes[p], bytes[p + 1], bytes[p + 2]);
+            p += 3;
+        } else if (b1 == op_rgba) {
+            if (p + 4 > end) {
+                break;
+            }
+            px = std::uint32_t(bytes[p + 3]) << 24 | std::uint32_t(bytes[p]) << 16
+                 | std::uint32_t(bytes[p + 1]) << 8 | bytes[p + 2];
+            p += 4;
+        } else if ((b1 & mask_2) == op_index) {
+            px = index[b1];
+        } else if ((b1 & mask_2) == op_diff) {
+            px = with_rgb(px,
+                          (px >> 16) + ((b1 >> 4) & 0x03) - 2,
+                          (px >> 8) + ((b1 >> 2) & 0x03) - 2,
+                          px + (b1 & 0x03) - 2);
+        } else if ((b1 & mask_2) == op_luma) {
+            if (p + 1 > end) {
+                break;
+            }
+            const auto b2 = bytes[p++];
+            const auto vg = std::uint32_t(b1 & 0x3f) - 32;
+            px = with_rgb(px,
+                          (px >> 16) + vg - 8 + ((b2 >> 4) & 0x0f),
+                          (px >> 8) + vg,
+                          px + vg - 8 + (b2 & 0x0f));
+        } else {
+            /// run of (b1 & 0x3f) + 1 previous pixels
+            const auto run = std::min<std::size_t>((b1 & 0x3f) + 1, count - i);
+            std::fill_n(result.matrix + i, run, px);
+            i += run;
+            index[hash(px)] = px;
+            continue;
+        }
+        index[hash(px)] = px;
+        result.matrix[i++] = px;
+    }
+
+    if (i < count) {
+        if (!allocate) {
+            delete[] result.matrix;
+        }
+        throw QOIDecodingException("decoding qoi failed. data is truncated");
+    }
+    return result;
+}
+
+void write(std::ostream &stream, const pixel_primitives::bitmap &bitmap)
+{
+    std::vector<std::uint8_t> bytes;
+    bytes.reserve(header_size + bitmap.width * bitmap.height + sizeof(end_marker));
+    bytes.insert(bytes.end(), {'q', 'o', 'i', 'f'});
+    write_u32(bytes, bitmap.width);
+    write_u32(bytes, bitmap.height);
+    bytes.push_back(4);
+    bytes.push_back(0);
+
+    std::array<std::uint32_t, 64> index{};
+    std::uint32_t prev = 0xff000000;
+    std::size_t run = 0;
+    const auto count = bitmap.width * bitmap.height;
+    for (std::size_t i = 0; i < count; ++i) {
+        const auto px = bitmap.matrix[i];
+        if (px == prev) {
+            if (++run == 62 || i + 1 == count) {
+                bytes.push_back(op_run | (run - 1));
+                run = 0;
+            }
+            continue;
+        }
+        if (run > 0) {
+            bytes.push_back(op_run | (run - 1));
+            run = 0;
+        }
+
+        const auto slot = hash(px);
+        if (index[slot] == px) {
+            bytes.push_back(op_index | slot);
+        } else {
+            index[slot] = px;
+            const std::uint8_t r = px >> 16;
+            const std::uint8_t g = px >> 8;
+            const std::uint8_t b = px;
+            if ((px >> 24) == (prev >> 24)) {
+                const std::int8_t vr = r - std::uint8_t(prev >> 16);
+                const std::int8_t vg = g - std::uint8_t(prev >> 8);
+                const std::int8_t vb = b - std::uint8_t(prev);
+                const std::int8_t vg_r = vr - vg;
+                const std::int8_t vg_b = vb - vg;
+                if (vr > -3 && vr < 2 && vg > -3 && vg < 2 && vb > -3 && vb < 2) {
+                    bytes.push_back(op_diff | (vr + 2) << 4 | (vg + 2) << 2 | (vb + 2));
+                } else if (vg_r > -9 && vg_r < 8 && vg > -33 && vg < 32 && vg_b > -9
+                           && vg_b < 8) {
+                    bytes.push_back(op_luma | (vg + 32));
+                    bytes.push_back((vg_r + 8) << 4 | (vg_b + 8));
+                } else {
+                    bytes.insert(bytes.end(), {op_rgb, r, g, b});
+                }
+            } else {
+                bytes.insert(bytes.end(), {op_rgba, r, g, b, std::uint8_t(px >> 24)});
+            }
+        }
+        prev = px;
+    }
+    bytes.insert(bytes.end(), std::begin(end_marker), std::end(end_marker));
+    stream.write(reinterpret_cast<const char *>(bytes.data()), bytes.size());
+}
+
+} // namespace e172::impl::console::qoi
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "png_reader.h"
+#include <ostream>
+
+namespace e172::impl::console::qoi {
+
+class QOIDecodingException : public std::exception
+{
+public:
+    QOIDecodingException(const char *what)
+        : m_what(what)
+    {}
+    const char *what() const noexcept { return m_what; }
+
+private:
+    const char *m_what;
+};
+
+using Allocator = png::Allocator;
+
+/// Reads image size from header. Returns false if stream is not a QOI image
+bool readSize(std::istream &stream, std::size_t &width, std::size_t &height);
+
+/// If `allocate` is empty result matrix is allocated with new[]
+pixel_primitives::bitmap read(std::istream &stream, const Allocator &allocate = {});
+
+/// Writes 4 channel image
+void write(std::ostream &stream, const pixel_primitives::bitmap &bitmap);
+
+} // namespace e172::impl::console::qoi
@@ -0,0 +1,84 @@
+#include "rawimage.h"
+
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace e172::impl::console::raw {
+
+namespace {
+
+bool valid(const Header &header)
+{
+    return std::memcmp(header.magic, Header::Magic, sizeof(Header::Magic)) == 0
+           && header.version == Header::Version;
+}
+
+} // namespace
+
+bool readSize(std::istream &stream, std::size_t &width, std::size_t &height)
+{
+    Header header;
+    if (!stream.read(reinterpret_cast<char *>(&header), sizeof(header)) || !valid(header)
+        || header.byteOrder != Header::ByteOrderMark) {
+        return false;
+    }
+    width = header.width;
+    height = header.height;
+    return true;
+}
+
+Mapping map(const std::string &path)
+{
+    const auto fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw RawImageException("mapping raw image failed. file could not be opened");
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || std::size_t(st.st_size) < sizeof(Header)) {
+        ::close(fd);
+        throw RawImageException("mapping raw image failed. file is too small");
+    }
+
+    const std::size_t size = st.st_size;
+    const auto address = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (address == MAP_FAILED) {
+        throw RawImageException("mapping raw image failed. mmap failed");
+    }
+    std::shared_ptr<void> storage(address, [size](void *address) { ::munmap(address, size); });
+
+    const auto &header = *static_cast<const Header *>(address);
+    if (!valid(header)) {
+        throw RawImageException("mapping raw image failed. file is not recognized as raw image");
+    }
+    if (header.byteOrder != Header::ByteOrderMark) {
+        throw RawImageException("mapping raw image failed. file has foreign byte order");
+    }
+    const std::size_t width = header.width;
+    const std::size_t height = header.height;
+    if ((size - sizeof(Header)) / sizeof(std::uint32_t) < width * height) {
+        throw RawImageException("mapping raw image failed. data is truncated");
+    }
+
+    const auto matrix = reinterpret_cast<std::uint32_t *>(static_cast<std::uint8_t *>(address)
+                                                          + sizeof(Header));
+    return Mapping{pixel_primitives::bitmap{matrix, width, height}, std::move(storage)};
+}
+
+void write(std::ostream &stream, const pixel_primitives::bitmap &bitmap)
+{
+    Header header{};
+    std::memcpy(header.magic, Header::Magic, sizeof(Header::Magic));
+    header.version = Header::Version;
+    header.byteOrder = Header::ByteOrderMark;
+    header.width = bitmap.width;
+    header.height = bitmap.height;
+    stream.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    stream.write(reinterpret_cast<const char *>(bitmap.matrix),
+                 bitmap.width * bitmap.height * sizeof(std::uint32_t));
+}
+
+} // namespace e172::impl::console::raw
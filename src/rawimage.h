@@ -0,0 +1,59 @@
+#pragma once
+
+#include "pixelprimitives.h"
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <string>
+
+namespace e172::impl::console::raw {
+
+class RawImageException : public std::exception
+{
+public:
+    RawImageException(const char *what)
+        : m_what(what)
+    {}
+    const char *what() const noexcept { return m_what; }
+
+private:
+    const char *m_what;
+};
+
+/// Raw image container: this header followed by width * height native endian 0xAARRGGBB
+/// words, i.e. pixels are stored in the same layout as in memory and need no decoding
+struct Header
+{
+    static constexpr char Magic[8] = {'E', '1', '7', '2', 'A', 'R', 'G', 'B'};
+    static constexpr std::uint32_t Version = 1;
+    /// written in native byte order, so file from machine with other endianness is rejected
+    static constexpr std::uint32_t ByteOrderMark = 0x01020304;
+
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t byteOrder;
+    std::uint32_t width;
+    std::uint32_t height;
+    /// pads header to 64 bytes, so payload of mapped file is cache line aligned
+    std::uint8_t reserved[40];
+};
+
+static_assert(sizeof(Header) == 64);
+
+/// Reads image size from header. Returns false if stream is not a raw image
+bool readSize(std::istream &stream, std::size_t &width, std::size_t &height);
+
+struct Mapping
+{
+    pixel_primitives::bitmap bitmap;
+    /// keeps pages mapped
+    std::shared_ptr<void> storage;
+};
+
+/// Maps file privately: pages are loaded on first access and pixels can be modified
+/// without affecting the file
+Mapping map(const std::string &path);
+
+void write(std::ostream &stream, const pixel_primitives::bitmap &bitmap);
+
+} // namespace e172::impl::console::raw
@@ -0,0 +1,195 @@
+#include "rawterminal.h"
+
+#include <array>
+#include <cassert>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <unistd.h>
+
+namespace e172::impl::console {
+
+namespace {
+
+/// Fatal signals followed by job control ones
+constexpr std::array HookedSignals = {SIGHUP, SIGINT, SIGQUIT, SIGILL, SIGABRT, SIGFPE, SIGSEGV,
+                                      SIGBUS, SIGTERM, SIGTSTP, SIGCONT};
+
+/// Accessed from signal handler, so it is plain global data
+struct SavedState
+{
+    volatile sig_atomic_t active = false;
+    int fd = -1;
+    bool isTerminal = false;
+    termios attributes;
+    /// applied again when process is continued after being stopped
+    termios rawAttributes;
+    std::array<struct sigaction, HookedSignals.size()> handlers;
+    /// signals handled or ignored by application are left to it
+    std::array<bool, HookedSignals.size()> hooked;
+    /// written to stdout on restore
+    char disableModes[256];
+    std::size_t disableModesSize = 0;
+    /// written to stdout again on continue
+    char enableModes[256];
+    std::size_t enableModesSize = 0;
+};
+
+SavedState saved;
+
+/// Only async-signal-safe calls
+void restoreTerminal()
+{
+    if (saved.disableModesSize > 0) {
+        [[maybe_unused]] const auto res = write(STDOUT_FILENO,
+                                                saved.disableModes,
+                                                saved.disableModesSize);
+    }
+    if (saved.isTerminal) {
+        tcsetattr(saved.fd, TCSANOW, &saved.attributes);
+    }
+}
+
+/// Only async-signal-safe calls
+void applyRawMode()
+{
+    if (saved.isTerminal) {
+        tcsetattr(saved.fd, TCSANOW, &saved.rawAttributes);
+    }
+    if (saved.enableModesSize > 0) {
+        [[maybe_unused]] const auto res = write(STDOUT_FILENO,
+                                                saved.enableModes,
+                                                saved.enableModesSize);
+    }
+}
+
+void restoreHandlers()
+{
+    for (std::size_t i = 0; i < HookedSignals.size(); ++i) {
+        if (saved.hooked[i]) {
+            sigaction(HookedSignals[i], &saved.handlers[i], nullptr);
+        }
+    }
+}
+
+/// Gives terminal back to shell and stops with default action of SIGTSTP
+void suspend()
+{
+    restoreTerminal();
+
+    struct sigaction stop = {};
+    stop.sa_handler = SIG_DFL;
+    sigemptyset(&stop.sa_mask);
+    struct sigaction hook;
+    sigaction(SIGTSTP, &stop, &hook);
+
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGTSTP);
+    sigprocmask(SIG_UNBLOCK, &mask, nullptr);
+    raise(SIGTSTP);
+    /// continued here after SIGCONT, whose handler has entered raw mode again
+    sigaction(SIGTSTP, &hook, nullptr);
+}
+
+void resume()
+{
+    /// terminal settings of background process would stop it with SIGTTOU. Shell sends
+    /// SIGCONT again when the job is brought to foreground
+    if (saved.isTerminal && tcgetpgrp(saved.fd) != getpgrp()) {
+        return;
+    }
+    applyRawMode();
+}
+
+void handleSignal(int signal)
+{
+    const auto savedErrno = errno;
+    if (signal == SIGTSTP) {
+        if (saved.active) {
+            suspend();
+        }
+    } else if (signal == SIGCONT) {
+        if (saved.active) {
+            resume();
+        }
+    } else {
+        if (saved.active) {
+            saved.active = false;
+            restoreTerminal();
+            restoreHandlers();
+        }
+        raise(signal);
+    }
+    errno = savedErrno;
+}
+
+} // namespace
+
+RawTerminal::RawTerminal(int fd)
+    : m_fd(fd)
+{
+    assert(!saved.active);
+
+    saved.fd = fd;
+    saved.isTerminal = tcgetattr(fd, &saved.attributes) == 0;
+    saved.disableModesSize = 0;
+    saved.enableModesSize = 0;
+    m_isTerminal = saved.isTerminal;
+    m_generatesSignals = m_isTerminal && (saved.attributes.c_lflag & ISIG) != 0;
+
+    struct sigaction action = {};
+    action.sa_handler = handleSignal;
+    sigemptyset(&action.sa_mask);
+    /// stopping must not interrupt restore on continue and vice versa
+    sigaddset(&action.sa_mask, SIGTSTP);
+    sigaddset(&action.sa_mask, SIGCONT);
+
+    if (m_isTerminal) {
+        auto &attributes = saved.rawAttributes;
+        attributes = saved.attributes;
+        attributes.c_lflag &= ~(ICANON | ECHO | ECHOE | ECHOK | ECHONL | ECHOPRT | ECHOKE);
+        /// reads return what is available without waiting. O_NONBLOCK is not used since it
+        /// is a flag of open file description, which stdin shares with stdout of terminal
+        attributes.c_cc[VTIME] = 0;
+        attributes.c_cc[VMIN] = 0;
+        tcsetattr(fd, TCSANOW, &attributes);
+    }
+
+    for (std::size_t i = 0; i < HookedSignals.size(); ++i) {
+        sigaction(HookedSignals[i], nullptr, &saved.handlers[i]);
+        const auto &previous = saved.handlers[i];
+        saved.hooked[i] = (previous.sa_flags & SA_SIGINFO) == 0 && previous.sa_handler == SIG_DFL;
+        if (saved.hooked[i]) {
+            sigaction(HookedSignals[i], &action, nullptr);
+        }
+    }
+    saved.active = true;
+}
+
+void RawTerminal::enableMode(std::string_view enable, std::string_view disable)
+{
+    if (!isatty(STDOUT_FILENO)
+        || saved.disableModesSize + disable.size() > sizeof(saved.disableModes)
+        || saved.enableModesSize + enable.size() > sizeof(saved.enableModes)) {
+        return;
+    }
+    [[maybe_unused]] const auto res = write(STDOUT_FILENO, enable.data(), enable.size());
+    /// prepended, so modes are disabled in reverse order
+    std::memmove(saved.disableModes + disable.size(), saved.disableModes, saved.disableModesSize);
+    std::memcpy(saved.disableModes, disable.data(), disable.size());
+    saved.disableModesSize += disable.size();
+    std::memcpy(saved.enableModes + saved.enableModesSize, enable.data(), enable.size());
+    saved.enableModesSize += enable.size();
+}
+
+RawTerminal::~RawTerminal()
+{
+    if (saved.active) {
+        saved.active = false;
+        restoreTerminal();
+        restoreHandlers();
+    }
+}
+
+} // namespace e172::impl::console
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string_view>
+#include <termios.h>
+
+namespace e172::impl::console {
+
+/// Switches terminal of `fd` into non-canonical mode without echo, in which reads return
+/// available input without waiting, for lifetime of the object. Previous settings are
+/// restored on destruction and also when process is killed by a fatal signal (the signal is
+/// then re-raised with default disposition). On SIGTSTP settings are restored before stopping
+/// and raw mode with enabled modes is applied again on SIGCONT. Signals handled or ignored by
+/// the application are not hooked, it must destroy the object itself. Only one instance may
+/// exist at a time
+class RawTerminal
+{
+public:
+    explicit RawTerminal(int fd);
+    RawTerminal(const RawTerminal &) = delete;
+    RawTerminal &operator=(const RawTerminal &) = delete;
+    ~RawTerminal();
+
+    int fd() const { return m_fd; }
+
+    /// False if `fd` is not a terminal. Reads from it may block, so they should follow poll()
+    bool isTerminal() const { return m_isTerminal; }
+
+    /// True if terminal sends signals for interrupt keys (ISIG), which raw mode keeps
+    bool generatesSignals() const { return m_generatesSignals; }
+
+    /// Writes `enable` (e.g. DEC private mode set) to stdout if it is a terminal and writes
+    /// `disable` when settings are restored. Disable sequences are written in reverse order
+    /// of enabling
+    void enableMode(std::string_view enable, std::string_view disable);
+
+private:
+    int m_fd;
+    bool m_isTerminal = false;
+    bool m_generatesSignals = false;
+};
+
+} // namespace e172::impl::console
@@ -0,0 +1,133 @@
+#include "recording.h"
+
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+namespace e172::impl::console::recording {
+
+namespace {
+
+constexpr std::size_t ChunkAlignment = 8;
+
+std::size_t padded(std::size_t size)
+{
+    return (size + ChunkAlignment - 1) / ChunkAlignment * ChunkAlignment;
+}
+
+} // namespace
+
+Recorder::Recorder(const std::string &path, Kind kind)
+    : m_stream(path, std::ios::out | std::ios::binary | std::ios::trunc)
+    , m_start(Clock::now())
+{
+    if (!m_stream) {
+        throw RecordingException("creating recording failed. file could not be opened");
+    }
+    Header header{};
+    std::memcpy(header.magic, Header::Magic, sizeof(Header::Magic));
+    header.version = Header::Version;
+    header.byteOrder = Header::ByteOrderMark;
+    header.kind = kind;
+    m_stream.write(reinterpret_cast<const char *>(&header), sizeof(header));
+}
+
+void Recorder::write(std::span<const std::uint8_t> bytes, Clock::time_point time)
+{
+    static constexpr char Padding[ChunkAlignment] = {};
+    const ChunkHeader chunk{
+        .time = std::uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(time - m_start)
+                                  .count()),
+        .size = bytes.size()};
+    m_stream.write(reinterpret_cast<const char *>(&chunk), sizeof(chunk));
+    m_stream.write(reinterpret_cast<const char *>(bytes.data()), bytes.size());
+    m_stream.write(Padding, padded(bytes.size()) - bytes.size());
+    ++m_chunkCount;
+}
+
+Player::Player(const std::string &path, Kind kind)
+{
+    const auto fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw RecordingException("mapping recording failed. file could not be opened");
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || std::size_t(st.st_size) < sizeof(Header)) {
+        ::close(fd);
+        throw RecordingException("mapping recording failed. file is too small");
+    }
+
+    const std::size_t size = st.st_size;
+    const auto address = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (address == MAP_FAILED) {
+        throw RecordingException("mapping recording failed. mmap failed");
+    }
+    m_storage = std::shared_ptr<void>(address, [size](void *address) { ::munmap(address, size); });
+    /// chunks are read once from start to end
+    ::madvise(address, size, MADV_SEQUENTIAL);
+
+    const auto &header = *static_cast<const Header *>(address);
+    if (std::memcmp(header.magic, Header::Magic, sizeof(Header::Magic)) != 0
+        || header.version != Header::Version) {
+        throw RecordingException("mapping recording failed. file is not recognized as recording");
+    }
+    if (header.byteOrder != Header::ByteOrderMark) {
+        throw RecordingException("mapping recording failed. file has foreign byte order");
+    }
+    if (header.kind != kind) {
+        throw RecordingException("mapping recording failed. recording is of other kind");
+    }
+    m_data = static_cast<const std::uint8_t *>(address);
+    m_size = size;
+}
+
+std::optional<Player::Chunk> Player::next()
+{
+    const auto chunk = chunkAt(m_offset);
+    if (!chunk) {
+        return std::nullopt;
+    }
+    const auto bytes = m_data + m_offset + sizeof(ChunkHeader);
+    m_offset += sizeof(ChunkHeader) + padded(chunk->size);
+    return Chunk{std::chrono::duration_cast<Clock::duration>(std::chrono::nanoseconds(chunk->time)),
+                 std::span(bytes, chunk->size)};
+}
+
+std::optional<Clock::duration> Player::peekTime() const
+{
+    if (const auto chunk = chunkAt(m_offset)) {
+        return std::chrono::duration_cast<Clock::duration>(std::chrono::nanoseconds(chunk->time));
+    }
+    return std::nullopt;
+}
+
+const ChunkHeader *Player::chunkAt(std::size_t offset) const
+{
+    /// padding of the last chunk may be missing too
+    if (offset > m_size || m_size - offset < sizeof(ChunkHeader)) {
+        return nullptr;
+    }
+    const auto chunk = reinterpret_cast<const ChunkHeader *>(m_data + offset);
+    if (m_size - offset - sizeof(ChunkHeader) < chunk->size) {
+        return nullptr;
+    }
+    return chunk;
+}
+
+void play(Player &player, std::ostream &output, bool realTime)
+{
+    const auto start = Clock::now();
+    while (const auto chunk = player.next()) {
+        if (realTime) {
+            std::this_thread::sleep_until(start + chunk->time);
+        }
+        output.write(reinterpret_cast<const char *>(chunk->bytes.data()), chunk->bytes.size());
+        output.flush();
+    }
+}
+
+} // namespace e172::impl::console::recording
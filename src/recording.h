@@ -0,0 +1,112 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <span>
+#include <string>
+
+namespace e172::impl::console::recording {
+
+class RecordingException : public std::exception
+{
+public:
+    RecordingException(const char *what)
+        : m_what(what)
+    {}
+    const char *what() const noexcept { return m_what; }
+
+private:
+    const char *m_what;
+};
+
+using Clock = std::chrono::steady_clock;
+
+/// What chunks of a recording are: bytes read from stdin (replayed through the same parser,
+/// so replay is exact) or bytes of frames written by Writer
+enum class Kind : std::uint32_t { Input = 1, Frames = 2 };
+
+/// Recording: this header followed by chunks. Each chunk is ChunkHeader followed by `size`
+/// bytes padded to 8 bytes. Integers are in native byte order like in raw images
+struct Header
+{
+    static constexpr char Magic[8] = {'E', '1', '7', '2', 'R', 'E', 'C', 'S'};
+    static constexpr std::uint32_t Version = 1;
+    static constexpr std::uint32_t ByteOrderMark = 0x01020304;
+
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t byteOrder;
+    Kind kind;
+    std::uint8_t reserved[44];
+};
+
+static_assert(sizeof(Header) == 64);
+
+struct ChunkHeader
+{
+    /// nanoseconds since the recording started
+    std::uint64_t time;
+    std::uint64_t size;
+};
+
+static_assert(sizeof(ChunkHeader) == 16);
+
+/// Appends chunks to a file. Time of each chunk is taken relative to construction
+class Recorder
+{
+public:
+    Recorder(const std::string &path, Kind kind);
+
+    void write(std::span<const std::uint8_t> bytes, Clock::time_point time = Clock::now());
+
+    std::size_t chunkCount() const { return m_chunkCount; }
+
+private:
+    std::ofstream m_stream;
+    const Clock::time_point m_start;
+    std::size_t m_chunkCount = 0;
+};
+
+/// Maps recording and iterates over its chunks without copying
+class Player
+{
+public:
+    struct Chunk
+    {
+        /// since the recording started
+        Clock::duration time;
+        std::span<const std::uint8_t> bytes;
+    };
+
+    Player(const std::string &path, Kind kind);
+
+    /// Next chunk or nullopt at the end. Truncated last chunk (recording interrupted while
+    /// written) is treated as the end
+    std::optional<Chunk> next();
+
+    /// Time of the chunk next() would return
+    std::optional<Clock::duration> peekTime() const;
+
+    void rewind() { m_offset = sizeof(Header); }
+
+private:
+    const ChunkHeader *chunkAt(std::size_t offset) const;
+
+private:
+    /// keeps pages mapped
+    std::shared_ptr<void> m_storage;
+    const std::uint8_t *m_data = nullptr;
+    std::size_t m_size = 0;
+    std::size_t m_offset = sizeof(Header);
+};
+
+/// Writes remaining chunks of `player` to `output`, flushing after each one. With `realTime`
+/// chunks are written at recorded offsets from the call, otherwise as fast as possible
+void play(Player &player, std::ostream &output, bool realTime = true);
+
+} // namespace e172::impl::console::recording
@@ -1,17 +1,142 @@
 #include "renderer.h"
 
+#include "imagedata.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
 namespace e172::impl::console {
 
+namespace {
+
+template<typename T, typename F>
+void forEachColored(std::span<const T> elements, std::span<const Color> colors, F &&f)
+{
+    const auto count = std::min(elements.size(), colors.size());
+    for (std::size_t i = 0; i < count; ++i) {
+        f(elements[i], colors[i]);
+    }
+}
+
+/// Larger coordinates are rejected, so conversion to integer and rasterizer arithmetic are
+/// defined. NaN and infinity fail the comparison as well
+constexpr double MaxCoordinate = double(std::int64_t(1) << 30);
+
+inline bool representable(double value)
+{
+    return std::abs(value) <= MaxCoordinate;
+}
+
+inline bool representable(const e172::Vector<double> &point)
+{
+    return representable(point.x()) && representable(point.y());
+}
+
+/// Decision variables of ellipse rasterizer are products of four radii
+constexpr double MaxEllipseRadius = double(std::int64_t(1) << 15);
+
+inline bool missesBitmap(const pixel_primitives::bitmap &btmp,
+                         std::int64_t min_x,
+                         std::int64_t min_y,
+                         std::int64_t max_x,
+                         std::int64_t max_y)
+{
+    return max_x < 0 || max_y < 0 || min_x >= std::int64_t(btmp.width)
+           || min_y >= std::int64_t(btmp.height);
+}
+
+} // namespace
+
 Renderer::Renderer(Private, std::ostream &output, const Style &style)
     : m_writer(Writer(output, style))
-{}
+{
+    m_effects.registerEffect(std::make_shared<GammaEffect>());
+    m_effects.registerEffect(std::make_shared<ContrastEffect>());
+    m_effects.registerEffect(std::make_shared<EdgeEnhancementEffect>());
+    m_effects.registerEffect(std::make_shared<ColorKeyEffect>());
+    m_effects.registerEffect(std::make_shared<VignetteEffect>());
+}
 
 bool Renderer::update()
 {
-    m_writer.writeFrame();
+    applyPostEffects();
+    if (!m_frameCaptures.empty()) {
+        captureFrame();
+    }
+    m_writer.writeFrame(&m_effects);
+    m_effects.frameDone();
     return true;
 }
 
+std::future<bool> Renderer::saveFrameAsync(const std::string &path,
+                                           const png::WriteOptions &options)
+{
+    const auto result = std::make_shared<std::promise<bool>>();
+    m_frameCaptures.push_back(FrameCapture{path, options, result});
+    return result->get_future();
+}
+
+std::future<bool> Renderer::saveImageAsync(const e172::Image &image,
+                                           const std::string &path,
+                                           const png::WriteOptions &options)
+{
+    std::promise<bool> result;
+    if (imageProvider(image) != provider()) {
+        result.set_value(false);
+        return result.get_future();
+    }
+
+    auto future = result.get_future();
+    /// holding buffer makes later writes to image unshare it
+    encoder().post([buffer = imageData<ImageData>(image).buffer(),
+                    path,
+                    options,
+                    result = std::make_shared<std::promise<bool>>(std::move(result))] {
+        result->set_value(png::save(path, buffer->bitmap(), options));
+    });
+    return future;
+}
+
+void Renderer::captureFrame()
+{
+    const auto &frame = m_writer.bitmap();
+    const auto pixels = std::make_shared<std::vector<std::uint32_t>>(frame.matrix,
+                                                                     frame.matrix
+                                                                         + frame.width
+                                                                               * frame.height);
+    for (auto &capture : m_frameCaptures) {
+        encoder().post([pixels,
+                        width = frame.width,
+                        height = frame.height,
+                        capture = std::move(capture)] {
+            const pixel_primitives::bitmap snapshot{pixels->data(), width, height};
+            capture.result->set_value(png::save(capture.path, snapshot, capture.options));
+        });
+    }
+    m_frameCaptures.clear();
+}
+
+WorkerPool &Renderer::encoder()
+{
+    if (!m_encoder) {
+        m_encoder = std::make_unique<WorkerPool>(1);
+    }
+    return *m_encoder;
+}
+
+std::string Renderer::presentEffectName(std::size_t index) const
+{
+    return index < m_effects.count() ? m_effects.effect(index)->name() : std::string();
+}
+
+void Renderer::drawEffect(std::size_t index, const VariantVector &parameters)
+{
+    if (index < m_effects.count()) {
+        m_effects.effect(index)->setParameters(parameters);
+        m_effects.enableOnce(index);
+    }
+}
+
 void Renderer::fill(Color color)
 {
     pixel_primitives::fill_area(m_writer.bitmap(), 0, 0, m_writer.bitmap().width, m_writer.bitmap().height, color);
@@ -35,7 +160,7 @@ void Renderer::drawRect(const e172::Vector<double> &point0,
                         const e172::ShapeFormat &format)
 {
     if(format.fill()) {
-        pixel_primitives::fill_area(m_writer.bitmap(), point0.x(), point0.y(), point1.x(), point1.y(), color);
+        pixel_primitives::fill_rect(m_writer.bitmap(), point0.x(), point0.y(), point1.x(), point1.y(), color);
     } else {
         pixel_primitives::draw_rect(m_writer.bitmap(), point0.x(), point0.y(), point1.x(), point1.y(), color);
     }
@@ -51,26 +176,412 @@ void Renderer::drawCircle(const e172::Vector<double> &center, double radius, Col
     pixel_primitives::draw_circle(m_writer.bitmap(), center.x(), center.y(), radius, color);
 }
 
+void Renderer::drawPixels(std::span<const e172::Vector<double>> points, Color color)
+{
+    auto &btmp = m_writer.bitmap();
+    const auto w = btmp.width;
+    const auto h = btmp.height;
+    const auto matrix = btmp.matrix;
+    if (!matrix) {
+        return;
+    }
+    /// out of bounds and non-finite points are written to a sink, so the loop has no branches
+    /// to mispredict
+    std::uint32_t sink;
+    for (const auto &point : points) {
+        const auto valid = representable(point);
+        const auto x = std::uint64_t(valid ? std::int64_t(point.x()) : -1);
+        const auto y = std::uint64_t(valid ? std::int64_t(point.y()) : -1);
+        *(x < w && y < h ? matrix + y * w + x : &sink) = color;
+    }
+}
+
+void Renderer::drawPixels(std::span<const e172::Vector<double>> points,
+                          std::span<const Color> colors)
+{
+    auto &btmp = m_writer.bitmap();
+    const auto w = btmp.width;
+    const auto h = btmp.height;
+    const auto matrix = btmp.matrix;
+    if (!matrix) {
+        return;
+    }
+    std::uint32_t sink;
+    forEachColored(points, colors, [w, h, matrix, &sink](const e172::Vector<double> &point, Color color) {
+        const auto valid = representable(point);
+        const auto x = std::uint64_t(valid ? std::int64_t(point.x()) : -1);
+        const auto y = std::uint64_t(valid ? std::int64_t(point.y()) : -1);
+        *(x < w && y < h ? matrix + y * w + x : &sink) = color;
+    });
+}
+
+void Renderer::drawLines(std::span<const Line> lines, Color color)
+{
+    for (const auto &line : lines) {
+        if (!representable(line.point0) || !representable(line.point1)) {
+            continue;
+        }
+        pixel_primitives::draw_line_clipped(m_writer.bitmap(),
+                                            line.point0.x(),
+                                            line.point0.y(),
+                                            line.point1.x(),
+                                            line.point1.y(),
+                                            color);
+    }
+}
+
+void Renderer::drawLines(std::span<const Line> lines, std::span<const Color> colors)
+{
+    forEachColored(lines, colors, [this](const Line &line, Color color) {
+        if (!representable(line.point0) || !representable(line.point1)) {
+            return;
+        }
+        pixel_primitives::draw_line_clipped(m_writer.bitmap(),
+                                            line.point0.x(),
+                                            line.point0.y(),
+                                            line.point1.x(),
+                                            line.point1.y(),
+                                            color);
+    });
+}
+
+void Renderer::drawRects(std::span<const Rect> rects, Color color, const ShapeFormat &format)
+{
+    const auto fill = format.fill();
+    for (const auto &rect : rects) {
+        rasterizeRect(rect, color, fill);
+    }
+}
+
+void Renderer::drawRects(std::span<const Rect> rects,
+                         std::span<const Color> colors,
+                         const ShapeFormat &format)
+{
+    const auto fill = format.fill();
+    forEachColored(rects, colors, [this, fill](const Rect &rect, Color color) {
+        rasterizeRect(rect, color, fill);
+    });
+}
+
+void Renderer::drawCircles(std::span<const Circle> circles, Color color, const ShapeFormat &format)
+{
+    auto &btmp = m_writer.bitmap();
+    if (!btmp) {
+        return;
+    }
+    const auto fill = format.fill();
+    for (const auto &circle : circles) {
+        rasterizeCircle(btmp, circle, color, fill);
+    }
+}
+
+void Renderer::drawCircles(std::span<const Circle> circles,
+                           std::span<const Color> colors,
+                           const ShapeFormat &format)
+{
+    auto &btmp = m_writer.bitmap();
+    if (!btmp) {
+        return;
+    }
+    const auto fill = format.fill();
+    forEachColored(circles, colors, [&btmp, fill](const Circle &circle, Color color) {
+        rasterizeCircle(btmp, circle, color, fill);
+    });
+}
+
+void Renderer::drawSquare(const e172::Vector<double> &center,
+                          double radius,
+                          Color color,
+                          const ShapeFormat &format)
+{
+    if (format.fill()) {
+        pixel_primitives::fill_rect(m_writer.bitmap(),
+                                    std::int64_t(center.x() - radius),
+                                    std::int64_t(center.y() - radius),
+                                    std::int64_t(center.x() + radius) + 1,
+                                    std::int64_t(center.y() + radius) + 1,
+                                    color);
+    } else {
+        drawSquare(center, radius, color);
+    }
+}
+
+void Renderer::drawCircle(const e172::Vector<double> &center,
+                          double radius,
+                          Color color,
+                          const ShapeFormat &format)
+{
+    auto &btmp = m_writer.bitmap();
+    if (btmp) {
+        rasterizeCircle(btmp, Circle{.center = center, .radius = radius}, color, format.fill());
+    }
+}
+
+void Renderer::drawEllipse(const e172::Vector<double> &center,
+                           const e172::Vector<double> &radius,
+                           Color color,
+                           const ShapeFormat &format)
+{
+    auto &btmp = m_writer.bitmap();
+    if (!btmp || !representable(center) || !(radius.x() >= 0 && radius.x() <= MaxEllipseRadius)
+        || !(radius.y() >= 0 && radius.y() <= MaxEllipseRadius)) {
+        return;
+    }
+    const auto x = std::int64_t(center.x());
+    const auto y = std::int64_t(center.y());
+    const auto rx = std::int64_t(radius.x());
+    const auto ry = std::int64_t(radius.y());
+    if (missesBitmap(btmp, x - rx, y - ry, x + rx, y + ry)) {
+        return;
+    }
+    if (format.fill()) {
+        pixel_primitives::fill_ellipse(btmp, x, y, rx, ry, color);
+    } else {
+        pixel_primitives::draw_ellipse(btmp, x, y, rx, ry, color);
+    }
+}
+
+void Renderer::drawTriangle(const e172::Vector<double> &point0,
+                            const e172::Vector<double> &point1,
+                            const e172::Vector<double> &point2,
+                            Color color,
+                            const ShapeFormat &format)
+{
+    const e172::Vector<double> points[] = {point0, point1, point2};
+    drawPolygon(points, color, format);
+}
+
+void Renderer::drawPolygon(std::span<const e172::Vector<double>> points,
+                           Color color,
+                           const ShapeFormat &format)
+{
+    auto &btmp = m_writer.bitmap();
+    if (points.empty() || !btmp) {
+        return;
+    }
+    /// polygon is skipped if any vertex is not representable or it misses the bitmap
+    std::int64_t min_x = std::numeric_limits<std::int64_t>::max();
+    std::int64_t min_y = min_x;
+    std::int64_t max_x = std::numeric_limits<std::int64_t>::min();
+    std::int64_t max_y = max_x;
+    for (const auto &p : points) {
+        if (!representable(p)) {
+            return;
+        }
+        min_x = std::min(min_x, std::int64_t(p.x()));
+        min_y = std::min(min_y, std::int64_t(p.y()));
+        max_x = std::max(max_x, std::int64_t(p.x()));
+        max_y = std::max(max_y, std::int64_t(p.y()));
+    }
+    if (missesBitmap(btmp, min_x, min_y, max_x, max_y)) {
+        return;
+    }
+    if (format.fill()) {
+        std::vector<pixel_primitives::point> converted;
+        converted.reserve(points.size());
+        for (const auto &p : points) {
+            converted.push_back(pixel_primitives::point{.x = std::int64_t(p.x()),
+                                                        .y = std::int64_t(p.y())});
+        }
+        pixel_primitives::fill_convex_polygon(btmp, converted.data(), converted.size(), color);
+    } else {
+        for (std::size_t i = 0; i < points.size(); ++i) {
+            const auto &a = points[i];
+            const auto &b = points[(i + 1) % points.size()];
+            pixel_primitives::draw_line_clipped(btmp, a.x(), a.y(), b.x(), b.y(), color);
+        }
+    }
+}
+
+void Renderer::rasterizeRect(const Rect &rect, Color color, bool fill)
+{
+    if (!representable(rect.point0) || !representable(rect.point1)) {
+        return;
+    }
+    const std::int64_t x0 = rect.point0.x();
+    const std::int64_t y0 = rect.point0.y();
+    const std::int64_t x1 = rect.point1.x();
+    const std::int64_t y1 = rect.point1.y();
+    auto &btmp = m_writer.bitmap();
+    if (fill) {
+        pixel_primitives::fill_rect(btmp, x0, y0, x1, y1, color);
+    } else {
+        pixel_primitives::draw_line_clipped(btmp, x0, y0, x1, y0, color);
+        pixel_primitives::draw_line_clipped(btmp, x1, y0, x1, y1, color);
+        pixel_primitives::draw_line_clipped(btmp, x1, y1, x0, y1, color);
+        pixel_primitives::draw_line_clipped(btmp, x0, y1, x0, y0, color);
+    }
+}
+
+void Renderer::rasterizeCircle(pixel_primitives::bitmap &btmp,
+                               const Circle &circle,
+                               Color color,
+                               bool fill)
+{
+    if (!representable(circle.center.x()) || !representable(circle.center.y())
+        || !representable(circle.radius) || circle.radius < 0) {
+        return;
+    }
+    const auto x = std::int64_t(circle.center.x());
+    const auto y = std::int64_t(circle.center.y());
+    const auto r = std::int64_t(circle.radius);
+    /// circles missing the bitmap are rejected before rasterizing
+    if (missesBitmap(btmp, x - r, y - r, x + r, y + r)) {
+        return;
+    }
+    if (fill) {
+        pixel_primitives::fill_circle(btmp, x, y, r, color);
+    } else {
+        pixel_primitives::draw_circle(btmp, x, y, r, color);
+    }
+}
+
 void Renderer::drawImage(const e172::Image &image,
                          const e172::Vector<double> &center,
                          double angle,
                          double zoom)
 {
     if(imageProvider(image) == provider()) {
-        pixel_primitives::blit_transformed(m_writer.bitmap(),
-                                           imageData<pixel_primitives::bitmap>(image),
-                                           std::complex<double>(std::cos(angle), std::sin(angle)),
-                                           zoom,
-                                           center.x(),
-                                           center.y());
+        const auto &data = imageData<ImageData>(image);
+        if (!data.ready()) {
+            /// still being loaded asynchronously
+            return;
+        }
+        const auto rotor = std::complex<double>(std::cos(angle), std::sin(angle));
+        const bool axisAligned = std::abs(rotor.imag()) < AxisAlignmentEpsilon && rotor.real() > 0;
+        if (axisAligned && std::abs(zoom - 1) < AxisAlignmentEpsilon && data.region()) {
+            /// atlas views are drawn from atlas rows without copying them out
+            blitRegion(data, center);
+            return;
+        }
+        /// minified images are sampled from mip level closest to requested zoom
+        const auto &btmp = data.level(zoom, zoom);
+        if (axisAligned && std::abs(zoom - 1) < AxisAlignmentEpsilon) {
+            pixel_primitives::blit_translated(m_writer.bitmap(),
+                                              btmp,
+                                              std::int64_t(center.x()) - std::int64_t(btmp.width / 2),
+                                              std::int64_t(center.y()) - std::int64_t(btmp.height / 2));
+        } else if (axisAligned) {
+            pixel_primitives::blit_scaled(m_writer.bitmap(), btmp, zoom, center.x(), center.y());
+        } else {
+            pixel_primitives::blit_transformed(m_writer.bitmap(), btmp, rotor, zoom, center.x(), center.y());
+        }
+    }
+}
+
+void Renderer::drawSprites(std::span<const Sprite> sprites)
+{
+    for (const auto &sprite : sprites) {
+        if (!sprite.image || imageProvider(*sprite.image) != provider()) {
+            continue;
+        }
+        const auto &data = imageData<ImageData>(*sprite.image);
+        if (!data.ready()) {
+            continue;
+        }
+        if (data.region()) {
+            blitRegion(data, sprite.center);
+        } else {
+            const auto &btmp = data.bitmap();
+            pixel_primitives::blit_translated(m_writer.bitmap(),
+                                              btmp,
+                                              std::int64_t(sprite.center.x())
+                                                  - std::int64_t(btmp.width / 2),
+                                              std::int64_t(sprite.center.y())
+                                                  - std::int64_t(btmp.height / 2));
+        }
     }
 }
 
+void Renderer::blitRegion(const ImageData &data, const e172::Vector<double> &center)
+{
+    const auto &region = *data.region();
+    pixel_primitives::blit_region(m_writer.bitmap(),
+                                  data.atlas()->bitmap(),
+                                  region.x,
+                                  region.y,
+                                  region.width,
+                                  region.height,
+                                  std::int64_t(center.x()) - std::int64_t(region.width / 2),
+                                  std::int64_t(center.y()) - std::int64_t(region.height / 2));
+}
+
 void Renderer::modifyBitmap(const std::function<void(e172::Color *)> &modifier)
 {
     modifier(m_writer.bitmap().matrix);
 }
 
+void Renderer::applyLensEffect(const e172::Vector<double> &point0,
+                               const e172::Vector<double> &point1,
+                               double coefficient)
+{
+    m_postEffects.push_back(PostEffect{.kind = PostEffect::Lens,
+                                       .point0 = point0,
+                                       .point1 = point1,
+                                       .coefficient = coefficient});
+}
+
+void Renderer::applySmooth(const e172::Vector<double> &point0,
+                           const e172::Vector<double> &point1,
+                           double coefficient)
+{
+    m_postEffects.push_back(PostEffect{.kind = PostEffect::Smooth,
+                                       .point0 = point0,
+                                       .point1 = point1,
+                                       .coefficient = coefficient});
+}
+
+const pixel_primitives::lens_map &Renderer::lensMap(std::size_t radius, double coefficient)
+{
+    const auto it = std::find_if(m_lensMaps.begin(), m_lensMaps.end(), [&](const auto &map) {
+        return map.radius == radius && map.coefficient == coefficient;
+    });
+    if (it != m_lensMaps.end()) {
+        m_lensMaps.splice(m_lensMaps.begin(), m_lensMaps, it);
+    } else {
+        m_lensMaps.push_front(pixel_primitives::make_lens_map(radius, coefficient));
+        if (m_lensMaps.size() > LensMapCacheCapacity) {
+            m_lensMaps.pop_back();
+        }
+    }
+    return m_lensMaps.front();
+}
+
+void Renderer::applyPostEffects()
+{
+    const auto &btmp = m_writer.bitmap();
+    for (const auto &effect : m_postEffects) {
+        if (!representable(effect.point0.x()) || !representable(effect.point0.y())
+            || !representable(effect.point1.x()) || !representable(effect.point1.y())
+            || !representable(effect.coefficient)) {
+            continue;
+        }
+        switch (effect.kind) {
+        case PostEffect::Lens: {
+            /// lens map has (2 * radius + 1)^2 entries, larger lens would not fit the bitmap
+            const auto radius = std::min(std::hypot(effect.point1.x() - effect.point0.x(),
+                                                    effect.point1.y() - effect.point0.y()),
+                                         std::hypot(double(btmp.width), double(btmp.height)));
+            pixel_primitives::apply_lens(m_writer.bitmap(),
+                                         lensMap(std::lround(radius), effect.coefficient),
+                                         std::lround(effect.point0.x()),
+                                         std::lround(effect.point0.y()));
+            break;
+        }
+        case PostEffect::Smooth:
+            pixel_primitives::blur(m_writer.bitmap(),
+                                   std::lround(effect.point0.x()),
+                                   std::lround(effect.point0.y()),
+                                   std::lround(effect.point1.x()),
+                                   std::lround(effect.point1.y()),
+                                   std::max<long>(std::lround(effect.coefficient), 0),
+                                   SmoothPasses);
+            break;
+        }
+    }
+    m_postEffects.clear();
+}
+
 void Renderer::setFullscreen(bool value)
 {
     m_writer.setAutoResize(value);
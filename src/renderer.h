@@ -1,7 +1,13 @@
 #pragma once
 
+#include "effects.h"
+#include "png_writer.h"
 #include "surface.h"
+#include "workerpool.h"
 #include <e172/graphics/abstractrenderer.h>
+#include <future>
+#include <list>
+#include <span>
 
 namespace e172 {
 class Variant;
@@ -11,6 +17,7 @@ using VariantVector = std::vector<e172::Variant>;
 namespace e172::impl::console {
 
 class GraphicsProvider;
+class ImageData;
 
 class Renderer : public e172::AbstractRenderer
 {
@@ -21,15 +28,104 @@ class Renderer : public e172::AbstractRenderer
 public:
     Renderer(Private, std::ostream &output, const Style &style);
 
+    /// Effects are applied while frame is written. Gamma, contrast, edge enhancement,
+    /// color key and vignette are registered by default (disabled). Returns index of effect
+    std::size_t registerEffect(const std::shared_ptr<Effect> &effect)
+    {
+        return m_effects.registerEffect(effect);
+    }
+
+    const EffectChain &effects() const { return m_effects; }
+
+    struct Line
+    {
+        e172::Vector<double> point0;
+        e172::Vector<double> point1;
+    };
+
+    struct Rect
+    {
+        e172::Vector<double> point0;
+        e172::Vector<double> point1;
+    };
+
+    struct Circle
+    {
+        e172::Vector<double> center;
+        double radius;
+    };
+
+    /// Batched primitives. Elements are rasterized in one loop with clipping hoisted out of it.
+    /// Overloads with `colors` take color of every element (extra elements are ignored)
+    void drawPixels(std::span<const e172::Vector<double>> points, Color color);
+    void drawPixels(std::span<const e172::Vector<double>> points, std::span<const Color> colors);
+    void drawLines(std::span<const Line> lines, Color color);
+    void drawLines(std::span<const Line> lines, std::span<const Color> colors);
+    void drawRects(std::span<const Rect> rects, Color color, const e172::ShapeFormat &format);
+    void drawRects(std::span<const Rect> rects,
+                   std::span<const Color> colors,
+                   const e172::ShapeFormat &format);
+    void drawCircles(std::span<const Circle> circles, Color color, const e172::ShapeFormat &format);
+    void drawCircles(std::span<const Circle> circles,
+                     std::span<const Color> colors,
+                     const e172::ShapeFormat &format);
+
+    struct Sprite
+    {
+        const e172::Image *image;
+        e172::Vector<double> center;
+    };
+
+    /// Batched drawImage without rotation and zoom, in order of `sprites`. Images loaded
+    /// with GraphicsProvider::loadAtlas are blended straight from shared atlas, so sprites
+    /// packed together are read from neighbouring memory
+    void drawSprites(std::span<const Sprite> sprites);
+
+    /// Shapes which respect `ShapeFormat::fill()`. Filled shapes are drawn as horizontal spans
+    void drawSquare(const e172::Vector<double> &center,
+                    double radius,
+                    Color color,
+                    const e172::ShapeFormat &format);
+    void drawCircle(const e172::Vector<double> &center,
+                    double radius,
+                    Color color,
+                    const e172::ShapeFormat &format);
+    void drawEllipse(const e172::Vector<double> &center,
+                     const e172::Vector<double> &radius,
+                     Color color,
+                     const e172::ShapeFormat &format);
+    void drawTriangle(const e172::Vector<double> &point0,
+                      const e172::Vector<double> &point1,
+                      const e172::Vector<double> &point2,
+                      Color color,
+                      const e172::ShapeFormat &format);
+    /// `points` must form convex polygon if it is filled
+    void drawPolygon(std::span<const e172::Vector<double>> points,
+                     Color color,
+                     const e172::ShapeFormat &format);
+
+    /// Saves frame as PNG when it is complete (after lens and smooth effects, before effects
+    /// applied while writing). Render loop only pays for copying pixels, encoding runs on
+    /// background thread
+    std::future<bool> saveFrameAsync(const std::string &path,
+                                     const png::WriteOptions &options = png::WriteOptions::fast());
+
+    /// Encodes image as PNG on background thread. Pixels are shared with image (copy-on-write),
+    /// so image may be modified while it is encoded
+    std::future<bool> saveImageAsync(const e172::Image &image,
+                                     const std::string &path,
+                                     const png::WriteOptions &options = {});
+
     // AbstractRenderer interface
 protected:
     virtual bool update() override;
 
     // AbstractRenderer interface
 public:
-    virtual size_t presentEffectCount() const override { return 0; }
-    virtual std::string presentEffectName(std::size_t) const override { return ""; }
-    virtual void drawEffect(std::size_t, const e172::VariantVector &) override {}
+    virtual size_t presentEffectCount() const override { return m_effects.count(); }
+    virtual std::string presentEffectName(std::size_t index) const override;
+    /// Sets parameters of effect and enables it for the next frame
+    virtual void drawEffect(std::size_t index, const e172::VariantVector &parameters) override;
     virtual void setDepth(std::int64_t) override {}
     virtual void fill(Color color) override;
     virtual void drawPixel(const e172::Vector<double> &point, e172::Color color) override;
@@ -65,25 +161,67 @@ public:
 
     virtual void modifyBitmap(const std::function<void(e172::Color *bitmap)> &modifier) override;
 
-    virtual void applyLensEffect(const e172::Vector<double> &,
-                                 const e172::Vector<double> &,
-                                 double) override
-    {}
+    /// Lens with center in `point0` and radius equal to distance to `point1`.
+    /// Applied just before the frame is written
+    virtual void applyLensEffect(const e172::Vector<double> &point0,
+                                 const e172::Vector<double> &point1,
+                                 double coefficient) override;
 
-    virtual void applySmooth(const e172::Vector<double> &,
-                             const e172::Vector<double> &,
-                             double) override
-    {}
+    /// Blur of rect between `point0` and `point1` with radius `coefficient`.
+    /// Applied just before the frame is written
+    virtual void applySmooth(const e172::Vector<double> &point0,
+                             const e172::Vector<double> &point1,
+                             double coefficient) override;
 
-    virtual void enableEffect(std::uint64_t) override {}
-    virtual void disableEffect(std::uint64_t) override {}
+    virtual void enableEffect(std::uint64_t index) override { m_effects.setEnabled(index, true); }
+    virtual void disableEffect(std::uint64_t index) override { m_effects.setEnabled(index, false); }
     virtual void setFullscreen(bool value) override;
     virtual void setResolution(const e172::Vector<std::uint32_t> &value) override;
     virtual e172::Vector<std::uint32_t> resolution() const override;
 
 private:
+    const pixel_primitives::lens_map &lensMap(std::size_t radius, double coefficient);
+    void rasterizeRect(const Rect &rect, Color color, bool fill);
+    static void rasterizeCircle(pixel_primitives::bitmap &btmp,
+                                const Circle &circle,
+                                Color color,
+                                bool fill);
+    void applyPostEffects();
+    void captureFrame();
+    /// `data` must be a view of atlas region
+    void blitRegion(const ImageData &data, const e172::Vector<double> &center);
+    WorkerPool &encoder();
+
+private:
+    struct FrameCapture
+    {
+        std::string path;
+        png::WriteOptions options;
+        std::shared_ptr<std::promise<bool>> result;
+    };
+
+    struct PostEffect
+    {
+        enum Kind { Lens, Smooth } kind;
+        e172::Vector<double> point0;
+        e172::Vector<double> point1;
+        double coefficient;
+    };
+
+    static constexpr std::size_t LensMapCacheCapacity = 8;
+    /// images with rotation and zoom closer than this to identity take translate/scale fast paths
+    static constexpr double AxisAlignmentEpsilon = 1e-9;
+    static constexpr std::size_t SmoothPasses = 3;
+
     Writer m_writer;
     Vector<double> m_position;
+    std::vector<PostEffect> m_postEffects;
+    EffectChain m_effects;
+    /// most recently used first
+    std::list<pixel_primitives::lens_map> m_lensMaps;
+    std::vector<FrameCapture> m_frameCaptures;
+    /// single thread, created on first save
+    std::unique_ptr<WorkerPool> m_encoder;
 };
 
 } // namespace e172::impl::console
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <optional>
+
+namespace e172::impl::console {
+
+/// Bounded wait-free queue for exactly one producer thread and one consumer thread.
+/// `Capacity` must be a power of two
+template<typename T, std::size_t Capacity>
+class SpscQueue
+{
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0,
+                  "capacity must be a power of two");
+
+public:
+    /// Producer side. Returns false if queue is full
+    bool tryPush(T value)
+    {
+        const auto tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_cachedHead == Capacity) {
+            m_cachedHead = m_head.load(std::memory_order_acquire);
+            if (tail - m_cachedHead == Capacity) {
+                return false;
+            }
+        }
+        m_slots[tail & Mask] = std::move(value);
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// Consumer side
+    std::optional<T> tryPop()
+    {
+        const auto head = m_head.load(std::memory_order_relaxed);
+        if (head == m_cachedTail) {
+            m_cachedTail = m_tail.load(std::memory_order_acquire);
+            if (head == m_cachedTail) {
+                return std::nullopt;
+            }
+        }
+        auto &slot = m_slots[head & Mask];
+        std::optional<T> result = std::move(slot);
+        slot.reset();
+        m_head.store(head + 1, std::memory_order_release);
+        return result;
+    }
+
+    /// Approximate when called concurrently with push or pop
+    bool empty() const
+    {
+        return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire);
+    }
+
+    static constexpr std::size_t capacity() { return Capacity; }
+
+private:
+    static constexpr std::size_t Mask = Capacity - 1;
+    /// indices of producer and consumer are kept on separate cache lines
+    static constexpr std::size_t CacheLine = 64;
+
+    std::array<std::optional<T>, Capacity> m_slots;
+    /// written by consumer
+    alignas(CacheLine) std::atomic<std::size_t> m_head = 0;
+    std::size_t m_cachedTail = 0;
+    /// written by producer
+    alignas(CacheLine) std::atomic<std::size_t> m_tail = 0;
+    std::size_t m_cachedHead = 0;
+};
+
+} // namespace e172::impl::console
@@ -1,6 +1,10 @@
 #include "surface.h"
 
+#include "effects.h"
+#include "latency.h"
+#include "recording.h"
 #include <cerrno>
+#include <cmath>
 #include <cstdio>
 #include <e172/consolecolor.h>
 #include <ext/stdio_filebuf.h>
@@ -99,24 +103,43 @@ void Writer::setFrameSize(std::size_t w, std::size_t h)
                 delete m_bitmap.matrix;
             }
             m_bitmap = pixel_primitives::bitmap { new uint32_t[w * h], w, h };
+            m_columns.clear();
         }
     }
 }
 
-std::size_t Writer::writeFrame()
+std::size_t Writer::writeFrame(const EffectChain *effects)
 {
     std::size_t result = 0;
     if(m_bitmap && m_bitmap.width > 0 && m_bitmap.height > 0) {
-        const auto w = m_bitmap.width / m_style.symbolWHFraction;
+        /// partly covered last cell is written too, its column is clamped in m_columns
+        const auto w = static_cast<std::size_t>(
+            std::ceil(m_bitmap.width / m_style.symbolWHFraction));
         const auto h = m_bitmap.height;
 
+        if (m_columns.size() != w) {
+            m_columns.resize(w);
+            for (std::size_t x = 0; x < w; ++x) {
+                m_columns[x] = std::min<std::size_t>(x * m_style.symbolWHFraction,
+                                                     m_bitmap.width - 1);
+            }
+            m_row.resize(w);
+        }
+        const bool applyEffects = effects && effects->active();
+
         std::string buffer; //{ buffer.reserve(); }
         std::string lastColorCode;
         for(std::size_t y = 0; y < h; ++y) {
+            const auto src = m_bitmap.matrix + y * m_bitmap.width;
+            for (std::size_t x = 0; x < w; ++x) {
+                m_row[x] = src[m_columns[x]];
+            }
+            if (applyEffects) {
+                effects->apply(m_bitmap, y, m_columns.data(), m_row.data(), w);
+            }
+
             for(std::size_t x = 0; x < w; ++x) {
-                std::uint32_t argb = pixel_primitives::pixel(m_bitmap,
-                                                             x * m_style.symbolWHFraction,
-                                                             y);
+                std::uint32_t argb = m_row[x];
 
                 if (m_style.ignoreAlpha) {
                     argb |= 0xff000000;
@@ -138,9 +161,18 @@ std::size_t Writer::writeFrame()
             }
             buffer += '\n';
         }
+        /// reset is part of the frame, so recorded frames replay byte for byte
+        buffer += e172::cc::Default;
         m_output.write(buffer.c_str(), buffer.size());
-        m_output << e172::cc::Default;
         result = buffer.size();
+        if (m_frameRecorder) {
+            m_frameRecorder->write(std::span(reinterpret_cast<const std::uint8_t *>(buffer.data()),
+                                             buffer.size()));
+        }
+        if (m_latencyTracker) {
+            m_output.flush();
+            m_latencyTracker->frameWritten(LatencyTracker::Clock::now());
+        }
     }
     if (m_autoResize) {
         const auto &size = outputStreamSize(m_output, m_style.symbolWHFraction);
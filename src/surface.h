@@ -9,6 +9,13 @@
 
 namespace e172::impl::console {
 
+class EffectChain;
+class LatencyTracker;
+
+namespace recording {
+class Recorder;
+}
+
 static constexpr const char DefaultGradient[] = " .:!/r(l1Z4H9W8$@";
 
 struct Style
@@ -34,7 +41,9 @@ public:
                                                         double whFraction = 1);
 
     void setFrameSize(std::size_t w, std::size_t h);
-    std::size_t writeFrame();
+
+    /// `effects` are applied to each sampled row right before it is encoded
+    std::size_t writeFrame(const EffectChain *effects = nullptr);
 
     pixel_primitives::bitmap& bitmap() { return m_bitmap; }
     const pixel_primitives::bitmap& bitmap() const { return m_bitmap; }
@@ -45,13 +54,31 @@ public:
     void setAutoResize(bool v) { m_autoResize = v; }
 
     std::ostream &output() const;
+
+    /// When set, output is flushed after each frame and the tracker is told that the frame
+    /// was written
+    void setLatencyTracker(const std::shared_ptr<LatencyTracker> &tracker)
+    {
+        m_latencyTracker = tracker;
+    }
+
+    /// When set, bytes of every written frame are also recorded (recording::Kind::Frames)
+    void setFrameRecorder(const std::shared_ptr<recording::Recorder> &recorder)
+    {
+        m_frameRecorder = recorder;
+    }
     const Style &style() const { return m_style; }
 
 private:
     pixel_primitives::bitmap m_bitmap;
+    /// frame bitmap column of every output symbol
+    std::vector<std::size_t> m_columns;
+    std::vector<std::uint32_t> m_row;
     std::ostream &m_output;
     Style m_style;
     bool m_autoResize = true;
+    std::shared_ptr<LatencyTracker> m_latencyTracker;
+    std::shared_ptr<recording::Recorder> m_frameRecorder;
 };
 
 } // namespace e172::impl::console
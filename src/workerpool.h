@@ -0,0 +1,41 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace e172::impl::console {
+
+/// Fixed set of threads executing posted tasks in FIFO order
+class WorkerPool
+{
+public:
+    using Task = std::function<void()>;
+
+    WorkerPool(std::size_t threadCount = std::max(std::thread::hardware_concurrency(), 1u));
+    WorkerPool(const WorkerPool &) = delete;
+    WorkerPool &operator=(const WorkerPool &) = delete;
+
+    /// Finishes all posted tasks before joining
+    ~WorkerPool();
+
+    void post(Task task);
+
+    std::size_t threadCount() const { return m_threads.size(); }
+
+private:
+    void run();
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::deque<Task> m_tasks;
+    bool m_stopping = false;
+    std::vector<std::thread> m_threads;
+};
+
+} // namespace e172::impl::console
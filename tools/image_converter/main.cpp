@@ -0,0 +1,95 @@
+#include "../../src/png_reader.h"
+#include "../../src/png_writer.h"
+#include "../../src/qoi.h"
+#include "../../src/rawimage.h"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+using namespace e172::impl::console;
+
+namespace {
+
+void usage(const char *program)
+{
+    std::cerr << "usage: " << program << " <png|qoi|raw> <input>...\n"
+              << "Converts every input (png, qoi or raw) into <input without extension>.<format>\n";
+}
+
+pixel_primitives::bitmap read(const std::filesystem::path &path, raw::Mapping &mapping)
+{
+    std::ifstream ifile(path, std::ios::in | std::ios::binary);
+    char magic[sizeof(raw::Header::Magic)] = {};
+    ifile.read(magic, sizeof(magic));
+    ifile.clear();
+    ifile.seekg(0);
+    if (std::memcmp(magic, raw::Header::Magic, sizeof(magic)) == 0) {
+        mapping = raw::map(path);
+        return mapping.bitmap;
+    } else if (std::memcmp(magic, "qoif", 4) == 0) {
+        return qoi::read(ifile);
+    }
+    return png::read(ifile);
+}
+
+bool write(const std::filesystem::path &path,
+           const std::string &format,
+           const pixel_primitives::bitmap &bitmap)
+{
+    if (format == "png") {
+        return png::save(path, bitmap, png::WriteOptions{9, false});
+    }
+    std::ofstream ofile(path, std::ios::out | std::ios::binary);
+    if (format == "qoi") {
+        qoi::write(ofile, bitmap);
+    } else {
+        raw::write(ofile, bitmap);
+    }
+    ofile.close();
+    return !ofile.fail();
+}
+
+} // namespace
+
+int main(int argc, const char **argv)
+{
+    if (argc < 3) {
+        usage(argv[0]);
+        return 1;
+    }
+    const std::string format = argv[1];
+    if (format != "png" && format != "qoi" && format != "raw") {
+        usage(argv[0]);
+        return 1;
+    }
+
+    int result = 0;
+    for (int i = 2; i < argc; ++i) {
+        const std::filesystem::path input = argv[i];
+        auto output = input;
+        output.replace_extension(format);
+        /// writing would truncate input while it is read (or mapped for raw)
+        std::error_code ec;
+        if (std::filesystem::equivalent(input, output, ec)) {
+            std::cerr << input << ": is already " << format << "\n";
+            result = 1;
+            continue;
+        }
+        try {
+            raw::Mapping mapping;
+            const auto bitmap = read(input, mapping);
+            if (!write(output, format, bitmap)) {
+                std::cerr << output << ": can not write\n";
+                result = 1;
+            }
+            if (!mapping.storage) {
+                delete[] bitmap.matrix;
+            }
+        } catch (const std::exception &e) {
+            std::cerr << input << ": " << e.what() << "\n";
+            result = 1;
+        }
+    }
+    return result;
+}